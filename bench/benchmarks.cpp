@@ -0,0 +1,440 @@
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "../src/reconstructionengine.h"
+#include "../src/framepreprocessor.h"
+#include "../src/modeldata.h"
+#include "../src/meshwriter.h"
+#include "../src/imagewriter.h"
+#include "../src/modelstream.h"
+#include "../src/config.h"
+#include "../test/fixtures.h"
+
+/* Microbenchmarks of each stage of the reconstruction pipeline, run on the
+ * butterfly assets scaled to several model sizes. Every benchmark reports
+ * ns_per_px, the time per model pixel, which stays comparable across sizes. */
+
+/* side lengths of the square models, 480 is the full camera height */
+#define BENCH_SIZES Arg(120)->Arg(240)->Arg(480)
+
+static void setPixelCounter(benchmark::State &state, int pixels) {
+
+    state.counters["ns_per_px"] = benchmark::Counter(state.iterations() * (double)pixels * 1e-9,
+                                                     benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+static void BM_Undistort(benchmark::State &state) {
+
+    int size = state.range(0);
+    const Assets &a = loadAssets(size);
+
+    /* camera intrinsics as used by Camera, scaled to frame size */
+    double s = size / (double)IMG_HEIGHT;
+    cv::Mat K = cv::Mat::eye(3, 3, CV_64FC1);
+    K.at<double>(0,0) = 751.79662626559286 * s;
+    K.at<double>(1,1) = 750.65231364204442 * s;
+    K.at<double>(0,2) = 306.70009070155015 * s;
+    K.at<double>(1,2) = 216.11302664191402 * s;
+    cv::Mat dist = (cv::Mat_<double>(1,4) << -0.38694196102815248, 0.15311947060864667, 0.002582758567387712, 0.0036405418524754108);
+
+    FramePreprocessor preprocessor(K, dist, a.raw[0].cols, a.raw[0].rows);
+    cv::Mat dst(a.raw[0].size(), a.raw[0].type());
+    for (auto _ : state) {
+        preprocessor.undistort(a.raw[0], dst);
+        benchmark::DoNotOptimize(dst.data);
+    }
+    setPixelCounter(state, a.raw[0].rows*a.raw[0].cols);
+}
+BENCHMARK(BM_Undistort)->BENCH_SIZES;
+
+static void BM_AmbientCrop(benchmark::State &state) {
+
+    int size = state.range(0);
+    const Assets &a = loadAssets(size);
+    for (auto _ : state) {
+        cv::Mat img = FramePreprocessor::removeAmbient(a.raw[0], a.rawAmbient, size);
+        benchmark::DoNotOptimize(img.data);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_AmbientCrop)->BENCH_SIZES;
+
+/* phase correlation of the downsampled images, independent of the set size */
+static void BM_RegisterImages(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    const FrameSet &frameSet = loadAssets(size).frameSet;
+
+    std::vector<cv::Point> shifts;
+    for (auto _ : state) {
+        shifts = engine.registerImages(frameSet);
+        benchmark::DoNotOptimize(shifts.data());
+    }
+
+    /* test assets are still, any shift is a misregistration */
+    int maxShift = 0;
+    for (size_t k=0; k<shifts.size(); k++) {
+        maxShift = std::max(maxShift, std::max(std::abs(shifts[k].x), std::abs(shifts[k].y)));
+    }
+    state.counters["max_shift_px"] = maxShift;
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_RegisterImages)->BENCH_SIZES->Unit(benchmark::kMillisecond);
+
+static void BM_CalcNormals(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    ReconstructionParams p = engine.getParams();
+    cv::Mat Pgrads(size, size, CV_32F), Qgrads(size, size, CV_32F);
+
+    for (auto _ : state) {
+        engine.uploadImages(loadAssets(size).frameSet);
+        engine.calcNormals(p, Pgrads, Qgrads);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_CalcNormals)->BENCH_SIZES;
+
+/* robust mode selecting a light subset per pixel */
+static void BM_CalcNormalsRobust(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    ReconstructionParams p = engine.getParams();
+    p.robust = true;
+    cv::Mat Pgrads(size, size, CV_32F), Qgrads(size, size, CV_32F);
+
+    for (auto _ : state) {
+        engine.uploadImages(loadAssets(size).frameSet);
+        engine.calcNormals(p, Pgrads, Qgrads);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_CalcNormalsRobust)->BENCH_SIZES;
+
+/* normals of the foreground tiles only, including masking and resetting */
+static void BM_CalcNormalsForeground(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    ReconstructionParams p = engine.getParams();
+    cv::Mat Pgrads(size, size, CV_32F), Qgrads(size, size, CV_32F);
+
+    engine.setForegroundOnly(true);
+    for (auto _ : state) {
+        engine.uploadImages(loadAssets(size).frameSet);
+        engine.calcNormals(p, Pgrads, Qgrads);
+    }
+
+    /* share of the tiles actually processed */
+    state.counters["active_tiles"] = engine.getActiveTileShare();
+
+    engine.setForegroundOnly(false);
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_CalcNormalsForeground)->BENCH_SIZES;
+
+/* normals blended into the temporally filtered ones, including motion detection */
+static void BM_CalcNormalsTemporal(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    ReconstructionParams p = engine.getParams();
+    cv::Mat Pgrads(size, size, CV_32F), Qgrads(size, size, CV_32F);
+
+    engine.setTemporalFilter(true);
+    for (auto _ : state) {
+        engine.uploadImages(loadAssets(size).frameSet);
+        engine.calcNormals(p, Pgrads, Qgrads);
+    }
+    engine.setTemporalFilter(false);
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_CalcNormalsTemporal)->BENCH_SIZES;
+
+static void BM_FFT(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    cv::Mat Pgrads(size, size, CV_32F), Qgrads(size, size, CV_32F);
+    engine.uploadImages(loadAssets(size).frameSet);
+    engine.calcNormals(engine.getParams(), Pgrads, Qgrads);
+
+    /* forward transforms of both gradients, as done ahead of integration */
+    cv::Mat P, Q;
+    for (auto _ : state) {
+        cv::dft(Pgrads, P, cv::DFT_COMPLEX_OUTPUT);
+        cv::dft(Qgrads, Q, cv::DFT_COMPLEX_OUTPUT);
+        benchmark::DoNotOptimize(Q.data);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_FFT)->BENCH_SIZES;
+
+static void BM_GlobalHeights(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    ReconstructionParams p = engine.getParams();
+    cv::Mat Pgrads(size, size, CV_32F), Qgrads(size, size, CV_32F);
+    engine.uploadImages(loadAssets(size).frameSet);
+    engine.calcNormals(p, Pgrads, Qgrads);
+
+    for (auto _ : state) {
+        cv::Mat Z = engine.getGlobalHeights(Pgrads, Qgrads, p);
+        benchmark::DoNotOptimize(Z.data);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_GlobalHeights)->BENCH_SIZES;
+
+static void BM_UpdateNormals(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    ReconstructionParams p = engine.getParams();
+    p.unsharpScale = 1.0f;
+    cv::Mat Pgrads(size, size, CV_32F), Qgrads(size, size, CV_32F), Normals(size, size, CV_32FC3);
+    engine.uploadImages(loadAssets(size).frameSet);
+    engine.calcNormals(p, Pgrads, Qgrads);
+
+    for (auto _ : state) {
+        engine.updateNormals(p, Normals);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_UpdateNormals)->BENCH_SIZES;
+
+/* box filtered unsharp masking at 480 px, time should not grow with the radius */
+static void BM_UpdateNormalsRadius(benchmark::State &state) {
+
+    int size = 480;
+    ReconstructionEngine &engine = engineFor(size);
+    ReconstructionParams p = engine.getParams();
+    p.unsharpScale = 1.0f;
+    p.unsharpRadius = state.range(0);
+    cv::Mat Pgrads(size, size, CV_32F), Qgrads(size, size, CV_32F), Normals(size, size, CV_32FC3);
+    engine.uploadImages(loadAssets(size).frameSet);
+    engine.calcNormals(p, Pgrads, Qgrads);
+
+    for (auto _ : state) {
+        engine.updateNormals(p, Normals);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_UpdateNormalsRadius)->Arg(2)->Arg(8)->Arg(32);
+
+static void BM_Reconstruct(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    for (auto _ : state) {
+        ReconstructionResult result = engine.reconstruct(loadAssets(size).frameSet);
+        benchmark::DoNotOptimize(result.Zcoords.data);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_Reconstruct)->BENCH_SIZES;
+
+static void setAccuracyCounters(benchmark::State &state, const ReconstructionResult &precise, const ReconstructionResult &other) {
+
+    Accuracy accuracy = compareResults(precise, other);
+    state.counters["max_normal_err_deg"] = accuracy.maxNormalErrDeg;
+    state.counters["max_depth_err_rel"] = accuracy.maxDepthErrRel;
+}
+
+/* fast relaxed math variant, accuracy is reported against the precise kernels */
+static void BM_ReconstructFastMath(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    const FrameSet &frameSet = loadAssets(size).frameSet;
+
+    ReconstructionResult precise = engine.reconstruct(frameSet);
+    engine.setFastMath(true);
+    ReconstructionResult fast = engine.reconstruct(frameSet);
+    for (auto _ : state) {
+        ReconstructionResult result = engine.reconstruct(frameSet);
+        benchmark::DoNotOptimize(result.Zcoords.data);
+    }
+    engine.setFastMath(false);
+    setPixelCounter(state, size*size);
+    setAccuracyCounters(state, precise, fast);
+}
+BENCHMARK(BM_ReconstructFastMath)->BENCH_SIZES;
+
+/* fp16 storage of normals and gradients, accuracy against fp32 storage */
+static void BM_ReconstructHalfStorage(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionEngine &engine = engineFor(size);
+    const FrameSet &frameSet = loadAssets(size).frameSet;
+
+    ReconstructionResult precise = engine.reconstruct(frameSet);
+    engine.setHalfStorage(true);
+    ReconstructionResult half = engine.reconstruct(frameSet);
+    for (auto _ : state) {
+        ReconstructionResult result = engine.reconstruct(frameSet);
+        benchmark::DoNotOptimize(result.Zcoords.data);
+    }
+    engine.setHalfStorage(false);
+    setPixelCounter(state, size*size);
+    setAccuracyCounters(state, precise, half);
+}
+BENCHMARK(BM_ReconstructHalfStorage)->BENCH_SIZES;
+
+static void BM_ModelUpdate(benchmark::State &state) {
+
+    int size = state.range(0);
+    std::vector<cv::Mat> MatXYZN = engineFor(size).reconstruct(loadAssets(size).frameSet).toMatXYZN();
+    ModelData model(size, size);
+    for (auto _ : state) {
+        model.update(MatXYZN);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_ModelUpdate)->BENCH_SIZES;
+
+/* widget startup: grid points and full resolution strips */
+static void BM_ModelSetup(benchmark::State &state) {
+
+    int size = state.range(0);
+    for (auto _ : state) {
+        ModelData model(size, size);
+        benchmark::DoNotOptimize(model.getPolyData().GetPointer());
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_ModelSetup)->BENCH_SIZES->Unit(benchmark::kMillisecond);
+
+/* connectivity of one level of detail at full camera size, ids_per_tri is the
+   number of point ids submitted per rendered triangle; stride 0 stands for the
+   exported triangles, full resolution strips are built by the constructor */
+static void BM_ModelTopology(benchmark::State &state) {
+
+    int stride = state.range(0);
+    vtkIdType numIds = 0, numTriangles = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        ModelData model(IMG_HEIGHT, IMG_HEIGHT);
+        state.ResumeTiming();
+        vtkSmartPointer<vtkCellArray> cells = (stride == 0) ? model.getTriangles() : model.getStrips(stride);
+        /* a strip of n ids holds n-2 triangles */
+        numIds = cells->GetNumberOfConnectivityEntries() - cells->GetNumberOfCells();
+        numTriangles = (stride == 0) ? cells->GetNumberOfCells() : numIds - 2*cells->GetNumberOfCells();
+    }
+    state.counters["ids_per_tri"] = numIds / (double)std::max((vtkIdType)1, numTriangles);
+}
+BENCHMARK(BM_ModelTopology)->Arg(0)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond);
+
+static void BM_WritePLY(benchmark::State &state) {
+
+    int size = state.range(0);
+    ModelData model(size, size);
+    model.update(engineFor(size).reconstruct(loadAssets(size).frameSet).toMatXYZN());
+    for (auto _ : state) {
+        model.writePLY("bench_model.ply");
+    }
+    std::remove("bench_model.ply");
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_WritePLY)->BENCH_SIZES->Unit(benchmark::kMillisecond);
+
+static void BM_WriteSTL(benchmark::State &state) {
+
+    int size = state.range(0);
+    ModelData model(size, size);
+    model.update(engineFor(size).reconstruct(loadAssets(size).frameSet).toMatXYZN());
+    for (auto _ : state) {
+        model.writeSTL("bench_model.stl");
+    }
+    std::remove("bench_model.stl");
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_WriteSTL)->BENCH_SIZES->Unit(benchmark::kMillisecond);
+
+/* streaming writers of the background exporter, straight from heights and normals */
+static void BM_StreamPLY(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionResult result = engineFor(size).reconstruct(loadAssets(size).frameSet);
+    for (auto _ : state) {
+        MeshWriter::writePLY("bench_stream.ply", result.Zcoords, result.Normals);
+    }
+    std::remove("bench_stream.ply");
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_StreamPLY)->BENCH_SIZES->Unit(benchmark::kMillisecond);
+
+static void BM_StreamSTL(benchmark::State &state) {
+
+    int size = state.range(0);
+    ReconstructionResult result = engineFor(size).reconstruct(loadAssets(size).frameSet);
+    for (auto _ : state) {
+        MeshWriter::writeSTL("bench_stream.stl", result.Zcoords);
+    }
+    std::remove("bench_stream.stl");
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_StreamSTL)->BENCH_SIZES->Unit(benchmark::kMillisecond);
+
+/* compressing a model as recorded, with 16-bit (0) or float (1) heights; the
+   decoded model is compared with the original */
+static void BM_EncodeModel(benchmark::State &state) {
+
+    int size = 480;
+    bool floatDepth = state.range(0) != 0;
+    ReconstructionResult result = engineFor(size).reconstruct(loadAssets(size).frameSet);
+
+    QByteArray chunk;
+    for (auto _ : state) {
+        chunk = ModelStream::encode(result.Zcoords, result.Normals, 0, floatDepth);
+        benchmark::DoNotOptimize(chunk.data());
+    }
+
+    /* the round trip itself is checked by the model_stream test */
+    state.counters["ratio"] = (double)(size*size) * 4 * sizeof(float) / chunk.size();
+    cv::Mat Z, N;
+    if (ModelStream::decode(chunk, size, size, Z, N)) {
+        double zMin, zMax;
+        cv::minMaxLoc(result.Zcoords, &zMin, &zMax);
+        state.counters["max_z_err"] = cv::norm(Z, result.Zcoords, cv::NORM_INF) / std::max(zMax - zMin, 1e-6);
+        state.counters["max_n_err"] = cv::norm(N, result.Normals, cv::NORM_INF);
+    }
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_EncodeModel)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+/* depth and normal maps of a full size model as images, for comparison with the meshes above */
+static void BM_WriteMaps(benchmark::State &state) {
+
+    int size = 480;
+    ImageWriter::Format format = (ImageWriter::Format)state.range(0);
+    ReconstructionResult result = engineFor(size).reconstruct(loadAssets(size).frameSet);
+    std::string depthFile = std::string("bench_depth.") + ImageWriter::extension(format);
+    std::string normalsFile = std::string("bench_normals.") + ImageWriter::extension(format);
+    for (auto _ : state) {
+        ImageWriter::writeDepth(depthFile, result.Zcoords, format);
+        ImageWriter::writeNormals(normalsFile, result.Normals, format);
+    }
+    std::remove(depthFile.c_str());
+    std::remove(normalsFile.c_str());
+    setPixelCounter(state, size*size);
+}
+BENCHMARK(BM_WriteMaps)->Arg(ImageWriter::PNG)->Arg(ImageWriter::PNG16)->Arg(ImageWriter::TIFF_FLOAT)->Arg(ImageWriter::EXR)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,156 @@
+#include "batch.h"
+
+int Batch::run(const QString &inputDir, const QString &outputDir, bool albedo, ImageWriter::Format format) {
+
+    QStringList sets = findSets(inputDir);
+    if (sets.isEmpty()) {
+        std::cerr << "ERROR: No image sets found in " << inputDir.toStdString() << std::endl;
+        return 1;
+    }
+
+    /* outputs mirror the directory structure of the inputs */
+    QDir in(inputDir);
+    std::vector<Job> jobs;
+    for (int i=0; i<sets.size(); i++) {
+        Job job;
+        job.setDir = sets.at(i);
+        job.outDir = QDir(outputDir).filePath(in.relativeFilePath(sets.at(i)));
+        job.albedo = albedo;
+        job.format = format;
+        jobs.push_back(job);
+    }
+
+    /* independent sets are processed in parallel, one engine per worker */
+    int numWorkers = std::max(1, std::min(QThread::idealThreadCount(), (int)jobs.size()));
+    std::cout << "Reconstructing " << jobs.size() << " sets with " << numWorkers << " workers" << std::endl;
+
+    QAtomicInt nextJob(0);
+    std::vector< QFuture<int> > workers;
+    for (int i=0; i<numWorkers; i++) {
+        workers.push_back(QtConcurrent::run(&Batch::worker, &jobs, &nextJob));
+    }
+
+    int numFailed = 0;
+    for (size_t i=0; i<workers.size(); i++) {
+        numFailed += workers[i].result();
+    }
+    std::cout << "Finished " << jobs.size()-numFailed << " of " << jobs.size() << " sets" << std::endl;
+
+    return numFailed;
+}
+
+int Batch::worker(const std::vector<Job> *jobs, QAtomicInt *nextJob) {
+
+    ReconstructionEngine *engine = NULL;
+    int numFailed = 0;
+
+    for (int idx = nextJob->fetchAndAddOrdered(1); idx < (int)jobs->size(); idx = nextJob->fetchAndAddOrdered(1)) {
+        const Job &job = jobs->at(idx);
+
+        std::vector<cv::Mat> images;
+        int avgIntensity;
+        if (!loadSet(job.setDir, images, avgIntensity)) {
+            numFailed++;
+            continue;
+        }
+
+        /* engine (and its OpenCL context) is reused for sets of equal size */
+        int size = images[0].rows;
+        if (engine == NULL || engine->getWidth() != size) {
+            delete engine;
+            engine = new ReconstructionEngine(size, size, avgIntensity);
+        }
+        engine->setMinIntensity(avgIntensity);
+        engine->setAlbedo(job.albedo);
+
+        ReconstructionResult result = engine->reconstruct(images);
+        if (!writeMaps(job.outDir, result, job.format)) {
+            numFailed++;
+            continue;
+        }
+        std::cout << "..reconstructed " << job.setDir.toStdString() << std::endl;
+    }
+
+    delete engine;
+    return numFailed;
+}
+
+QStringList Batch::findSets(const QString &inputDir) {
+
+    QStringList sets;
+    QDirIterator it(inputDir, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    if (QFile::exists(QDir(inputDir).filePath("image0.png"))) {
+        sets << inputDir;
+    }
+    while (it.hasNext()) {
+        QString dir = it.next();
+        if (QFile::exists(QDir(dir).filePath("image0.png"))) {
+            sets << dir;
+        }
+    }
+    sets.sort();
+
+    return sets;
+}
+
+bool Batch::loadSet(const QString &setDir, std::vector<cv::Mat> &images, int &avgIntensity) {
+
+    QDir dir(setDir);
+    cv::Mat ambient = cv::imread(dir.filePath("image_ambient.png").toStdString(), CV_LOAD_IMAGE_GRAYSCALE);
+
+    cv::Size firstSize;
+    int firstType = -1;
+    for (int i=0; i<8; i++) {
+        QString file = dir.filePath(QString("image%1.png").arg(i));
+        cv::Mat img = cv::imread(file.toStdString(), CV_LOAD_IMAGE_GRAYSCALE);
+        if (img.empty()) {
+            std::cerr << "ERROR: Could not read " << file.toStdString() << std::endl;
+            return false;
+        }
+
+        /* the engine is built for the size of the first image, all others have to match it */
+        if (i == 0) {
+            firstSize = img.size();
+            firstType = img.type();
+        } else if (img.size() != firstSize || img.type() != firstType) {
+            std::cerr << "ERROR: " << file.toStdString() << " differs in size or type from image0.png, skipping " << setDir.toStdString() << std::endl;
+            return false;
+        }
+
+        /* remove ambient light, cropping image in center to quadratic size as done by camera class */
+        int size = std::min(img.rows, img.cols);
+        cv::Mat croppedImg;
+        if (ambient.size() == img.size()) {
+            croppedImg = FramePreprocessor::removeAmbient(img, ambient, size);
+        } else {
+            croppedImg = img(FramePreprocessor::cropRect(img, size)).clone();
+        }
+        images.push_back(croppedImg);
+    }
+
+    /* minimum intensity of reconstruction is adjusted by ambient light as in live mode */
+    avgIntensity = ambient.empty() ? 1 : std::max(1, (int)cv::mean(ambient)[0]);
+
+    return true;
+}
+
+bool Batch::writeMaps(const QString &outDir, const ReconstructionResult &result, ImageWriter::Format format) {
+
+    if (!QDir().mkpath(outDir)) {
+        std::cerr << "ERROR: Could not create " << outDir.toStdString() << std::endl;
+        return false;
+    }
+
+    QDir dir(outDir);
+    QString ext = ImageWriter::extension(format);
+    bool written = ImageWriter::writeDepth(dir.filePath("depth." + ext).toStdString(), result.Zcoords, format) &&
+                   ImageWriter::writeNormals(dir.filePath("normals." + ext).toStdString(), result.Normals, format);
+
+    if (written && !result.Albedo.empty()) {
+        written = ImageWriter::writeAlbedo(dir.filePath("albedo." + ext).toStdString(), result.Albedo, format);
+    }
+    if (!written) {
+        std::cerr << "ERROR: Could not write maps to " << outDir.toStdString() << std::endl;
+    }
+    return written;
+}
@@ -0,0 +1,53 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <iostream>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QThread>
+#include <QtCore/QFuture>
+#include <QtCore/QtConcurrentRun>
+
+#include "reconstructionengine.h"
+#include "framepreprocessor.h"
+#include "imagewriter.h"
+
+/** Headless reconstruction of recorded image sets. A set is a directory
+ * holding image0.png .. image7.png and optionally image_ambient.png, like
+ * assets/butterfly. */
+class Batch {
+
+public:
+    /** Reconstructing all sets found below inputDir in parallel, writing depth
+     * and normal maps (and albedo maps if requested) in given image format to
+     * the same relative location below outputDir.
+     * Returns number of sets which could not be processed. */
+    static int run(const QString &inputDir, const QString &outputDir, bool albedo = false, ImageWriter::Format format = ImageWriter::PNG);
+
+private:
+    struct Job {
+        QString setDir;
+        QString outDir;
+        bool albedo;
+        ImageWriter::Format format;
+    };
+
+    /** Worker processing jobs until none are left, owns its reconstruction engine */
+    static int worker(const std::vector<Job> *jobs, QAtomicInt *nextJob);
+    static QStringList findSets(const QString &inputDir);
+    /** Loading ambient subtracted and centered square cropped images of a set,
+     * false if an image is missing or differs in size or type from the first */
+    static bool loadSet(const QString &setDir, std::vector<cv::Mat> &images, int &avgIntensity);
+    static bool writeMaps(const QString &outDir, const ReconstructionResult &result, ImageWriter::Format format);
+};
+
+#endif
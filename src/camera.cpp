@@ -1,15 +1,19 @@
 #include "camera.h"
 
-Camera::Camera() {
+Camera::Camera() : camera(NULL), camList(NULL), eventLoopTimer(NULL), isStopped(false), recorder(NULL) {
 
+    /* a missing firewire bus is not fatal, recorded sessions can still be replayed */
+    numCams = 0;
     camDict = dc1394_new();
-    error = dc1394_camera_enumerate(camDict, &camList);
-    if (error != DC1394_SUCCESS) {
-        std::cerr << "Failed to enumerate cameras." << std::endl;
-        exit(EXIT_FAILURE);
+    if (camDict != NULL) {
+        error = dc1394_camera_enumerate(camDict, &camList);
+        if (error != DC1394_SUCCESS) {
+            std::cerr << "Failed to enumerate cameras." << std::endl;
+        } else {
+            numCams = camList->num;
+        }
     }
 
-    numCams = camList->num;
     numDMABuffers = 3;
     FRAME_RATE = 15;
     
@@ -52,21 +56,23 @@ Camera::Camera() {
     /* counter iterating over (modulo 8) LEDs assigning image to current LED */
     imgIdx = 3;
     testMode = false;
+    replayIdx = 0;
+    playbackMode = REALTIME;
+    playbackRate = FRAME_RATE;
     
     /* setup undistortion */
-    initUndistLUT();
+    preprocessor = new FramePreprocessor(K, dist, camFrameWidth, camFrameHeight);
 }
 
 Camera::~Camera() {
 
     stop();
-    delete[] map1LUT;
-	delete[] map2LUT;
+    delete preprocessor;
 }
 
 bool Camera::open(int deviceIdx) {
 
-    if (numCams < 1) {
+    if (numCams < 1 || deviceIdx >= numCams) {
         std::cerr << "Camera not found or could not be opened." << std::endl;
         return false;
     }
@@ -146,28 +152,96 @@ bool Camera::open(int deviceIdx) {
     return true;
 }
 
+int Camera::numDevices() {
+
+    return numCams;
+}
+
 void Camera::start() {
 
+    Trace::setThreadName("Camera");
+
     /* starting event loop, capturing fresh images */
-    eventLoopTimer = new QTimer();
+    eventLoopTimer = new QTimer(this);
     connect(eventLoopTimer, SIGNAL(timeout()), this, SLOT(captureFrame()));
     eventLoopTimer->start();
 }
 
+bool Camera::openReplay(const QString &filename) {
+
+    if (!replay.open(filename)) {
+        return false;
+    }
+
+    /* cropping to the same quadratic dimensions as for a live camera */
+    camFrameWidth = replay.width();
+    camFrameHeight = replay.height();
+    height = width = std::min(camFrameWidth, camFrameHeight);
+    replayIdx = 0;
+
+    /* recorded sessions carry their own ambient reference frame */
+    int ambientIdx = replay.ambientIndex();
+    if (ambientIdx != -1) {
+        ambientImage = replay.frame(ambientIdx).clone();
+    } else {
+        ambientImage = cv::Mat(camFrameHeight, camFrameWidth, CV_8UC1, cv::Scalar::all(0));
+    }
+    avgImgIntensity = cv::mean(ambientImage)[0];
+
+    /* undistortion lookup tables depend on frame dimensions */
+    delete preprocessor;
+    preprocessor = new FramePreprocessor(K, dist, camFrameWidth, camFrameHeight);
+
+    std::cout << "Replaying " << replay.frameCount() << " frames from " << filename.toStdString() << std::endl;
+    return true;
+}
+
+void Camera::setPlaybackMode(PlaybackMode mode, double fps) {
+
+    playbackMode = mode;
+    playbackRate = (fps > 0) ? fps : FRAME_RATE;
+}
+
+bool Camera::inReplayMode() {
+
+    return replay.isOpen();
+}
+
+void Camera::setRecorder(FrameRecorder *recorder) {
+
+    this->recorder = recorder;
+}
+
 void Camera::stop() {
 
-    eventLoopTimer->stop();
-    stopClockPulse();
-    dc1394_video_set_transmission(camera, DC1394_OFF);
-    dc1394_capture_stop(camera);
-    dc1394_camera_free(camera);
-    dc1394_free (camDict);
+    if (isStopped) {
+        return;
+    }
+    isStopped = true;
+
+    if (eventLoopTimer != NULL) {
+        eventLoopTimer->stop();
+    }
+    if (camera != NULL) {
+        stopClockPulse();
+        dc1394_video_set_transmission(camera, DC1394_OFF);
+        dc1394_capture_stop(camera);
+        dc1394_camera_free(camera);
+        camera = NULL;
+    }
+    if (camDict != NULL) {
+        dc1394_free(camDict);
+        camDict = NULL;
+    }
     
     emit stopped();
 }
 
 void Camera::setTestMode(bool toggle) {
     
+    if (toggle != testMode) {
+        emit sequenceRestarted();
+    }
     testMode = toggle;
 }
 
@@ -176,6 +250,16 @@ bool Camera::inTestMode() {
     return testMode;
 }
 
+int Camera::frameWidth() {
+
+    return camFrameWidth;
+}
+
+int Camera::frameHeight() {
+
+    return camFrameHeight;
+}
+
 int Camera::avgImageIntensity() {
     
     return avgImgIntensity;
@@ -242,47 +326,6 @@ void Camera::printStatus() {
     std::cout << "  strobe_1_cnt duration_value  : " << strobe_1_cnt_reg.duration_value << std::endl;
 }
 
-void Camera::initUndistLUT() {
-    
-    int stripeSize = std::min(std::max(1, (1 << 12) / std::max(camFrameWidth, 1)), camFrameHeight);
-    cv::Mat map1 = cv::Mat(stripeSize, camFrameWidth, CV_16SC2);
-    cv::Mat map2 = cv::Mat(stripeSize, camFrameWidth, CV_16UC1);
-    
-    map1LUT = new cv::Mat[camFrameHeight];
-    map2LUT = new cv::Mat[camFrameHeight];
-    
-    cv::Mat Ar;
-    K.convertTo(Ar, CV_64F);
-    
-    double v0 = K.at<double>(1,2);
-    for (int y = 0; y < camFrameHeight; y += stripeSize) {
-        int stripe = std::min(stripeSize, camFrameHeight - y);
-        Ar.at<double>(1,2) = v0 - y;
-        cv::Mat map1Part = map1.rowRange(0, stripe);
-        cv::Mat map2Part = map2.rowRange(0, stripe);
-        cv::initUndistortRectifyMap(K, dist, cv::noArray(), Ar, cv::Size(camFrameWidth, stripe), map1Part.type(), map1Part, map2Part);
-        map1LUT[y] = map1Part.clone();
-        map2LUT[y] = map2Part.clone();
-    }
-}
-
-void Camera::undistortLUT(cv::InputArray source, cv::OutputArray dest) {
-    
-    cv::Mat src = source.getMat();
-    dest.create(src.size(), src.type());
-    cv::Mat dst = dest.getMat();
-    
-    int stripeSize = std::min(std::max(1, (1 << 12) / std::max(camFrameWidth, 1)), camFrameHeight);
-    
-    for (int y = 0; y < src.rows; y += stripeSize) {
-        int stripe = std::min(stripeSize, src.rows - y);
-        cv::Mat map1Part = map1LUT[y];
-        cv::Mat map2Part = map2LUT[y];
-        cv::Mat destPart = dst.rowRange(y, y + stripe);
-        cv::remap(src, destPart, map1Part, map2Part, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
-    }
-}
-
 void Camera::captureAmbientImage() {
     
     /* capture image with no LEDs to subtract ambient light */
@@ -293,35 +336,112 @@ void Camera::captureAmbientImage() {
     dc1394_capture_enqueue(camera, frame);
 }
 
+int Camera::nextReplayFrame(cv::Mat &frame, bool &undistorted) {
+
+    if (replay.frameCount() == 0) {
+        return -1;
+    }
+
+    /* skipping ambient reference frames, looping at the end of the session */
+    int idx = replayIdx;
+    for (int i=0; i<replay.frameCount() && replay.ledIndex(idx) == FRAME_LED_AMBIENT; i++) {
+        idx = (idx+1) % replay.frameCount();
+    }
+    if (replay.ledIndex(idx) == FRAME_LED_AMBIENT) {
+        return -1;
+    }
+    int nextIdx = (idx+1) % replay.frameCount();
+
+    /* first frame of the session, or wrapped around while skipping */
+    if (replayIdx == 0 || idx < replayIdx) {
+        emit sequenceRestarted();
+    }
+
+    frame = replay.frame(idx);
+    undistorted = replay.isUndistorted(idx);
+
+    /* schedule next capture according to playback mode */
+    switch (playbackMode) {
+        case REALTIME: {
+            int64_t delta = replay.timestamp(nextIdx) - replay.timestamp(idx);
+            eventLoopTimer->setInterval((delta > 0) ? (int)(delta/1000) : 1000/FRAME_RATE);
+            break;
+        }
+        case FIXED_RATE:
+            eventLoopTimer->setInterval((int)(1000.0/playbackRate));
+            break;
+        case AS_FAST_AS_POSSIBLE:
+            eventLoopTimer->setInterval(0);
+            break;
+    }
+
+    replayIdx = nextIdx;
+    return replay.ledIndex(idx);
+}
+
 void Camera::captureFrame() {
 
-    cv::Mat distortedFrame(camFrameHeight, camFrameWidth, CV_8UC1);
-    imgIdx = (imgIdx+1) % 8;
+    TRACE_SCOPE("Camera::captureFrame");
 
-    if (testMode) {
+    cv::Mat distortedFrame(camFrameHeight, camFrameWidth, CV_8UC1);
+    cv::Mat camFrame(camFrameHeight, camFrameWidth, CV_8UC1);
+    dc1394video_frame_t *frame = NULL;
+    bool undistorted = false;
+    bool recording = (recorder != NULL && recorder->isRecording());
+    bool recordRaw = (recording && !recorder->recordsUndistorted());
+
+    if (inReplayMode()) {
+        /* led index is part of the recording, corrupt sequences are replayed as is */
+        int ledIdx = nextReplayFrame(distortedFrame, undistorted);
+        if (ledIdx < 0) {
+            /* nothing to replay, polling at the camera rate instead of spinning */
+            eventLoopTimer->setInterval(1000/FRAME_RATE);
+            return;
+        }
+        imgIdx = ledIdx % 8;
+    } else if (testMode) {
+        imgIdx = (imgIdx+1) % 8;
         distortedFrame = testImages[imgIdx].clone();
         /* faking camera image acquisition time */
         eventLoopTimer->setInterval(1000/FRAME_RATE);
     } else {
-        dc1394video_frame_t *frame = NULL;
+        imgIdx = (imgIdx+1) % 8;
+        TRACE_SCOPE("Camera::dequeue");
         error = dc1394_capture_dequeue(camera, DC1394_CAPTURE_POLICY_WAIT, &frame);
         distortedFrame.data = frame->image;
-        dc1394_capture_enqueue(camera, frame);
+        /* dma buffer is handed back to the driver below, recorded raw frames need their own copy */
+        if (recordRaw) {
+            distortedFrame = distortedFrame.clone();
+        }
     }
     
-    /* undistort camera image */
-    cv::Mat camFrame(camFrameHeight, camFrameWidth, CV_8UC1);
-    undistortLUT(distortedFrame, camFrame);
+    /* recorded timing is the time of capture, not the time the frame is queued */
+    int64_t captureTime = recording ? recorder->timestamp() : 0;
+
+    /* undistort camera image, mapped replay frames are read-only and therefore copied */
+    if (undistorted) {
+        distortedFrame.copyTo(camFrame);
+    } else {
+        TRACE_SCOPE("Camera::undistort");
+        preprocessor->undistort(distortedFrame, camFrame);
+    }
+    if (frame != NULL) {
+        dc1394_capture_enqueue(camera, frame);
+    }
+
+    /* queue frame for recording, neither frame is modified below */
+    if (recording) {
+        if (!recorder->hasAmbient()) {
+            recorder->append(ambientImage, FRAME_LED_AMBIENT, captureTime);
+        }
+        recorder->append(recordRaw ? distortedFrame : camFrame, imgIdx, captureTime);
+    }
     
     /* display original frame with ambient light in camera widget */
-    cv::Rect cropped((camFrame.cols-width)/2, (camFrame.rows-height)/2, width, height);
-    emit newCamFrame(camFrame(cropped).clone());
-    
-    /* remove ambient light */
-    camFrame -= ambientImage;
+    emit newCamFrame(camFrame(FramePreprocessor::cropRect(camFrame, width)).clone());
     
-    /* cropping image in center to power-of-2 size */
-    cv::Mat croppedFrame = camFrame(cropped).clone();
+    /* remove ambient light, cropping image in center to power-of-2 size */
+    cv::Mat croppedFrame = FramePreprocessor::removeAmbient(camFrame, ambientImage, width);
 
     /* assigning image id (current active LED) to pixel in 0,0 */
     croppedFrame.at<uchar>(0, 0) = imgIdx;
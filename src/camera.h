@@ -29,25 +29,45 @@
 #include "pio_dir_reg.h"
 #include "cam_init_reg.h"
 #include <dc1394/dc1394.h>
+#include "framecontainer.h"
+#include "framerecorder.h"
+#include "framepreprocessor.h"
+#include "trace.h"
 #include "config.h"
 
 class Camera : public QObject {
     Q_OBJECT
 
 public:
+    /** playback speed when replaying a recorded session */
+    enum PlaybackMode { REALTIME, FIXED_RATE, AS_FAST_AS_POSSIBLE };
+
     Camera();
     ~Camera();
     bool open(int deviceIdx);
-    void stop();
+    /** Number of cameras found on the firewire bus */
+    int numDevices();
+    /** Replaying a recorded session instead of capturing from a device */
+    bool openReplay(const QString &filename);
+    void setPlaybackMode(PlaybackMode mode, double fps = 15.0);
+    bool inReplayMode();
+    /** Attach recorder receiving every captured frame while it is recording */
+    void setRecorder(FrameRecorder *recorder);
     void reset();
     void setTestMode(bool toggle);
     void printStatus();
     int avgImageIntensity();
     bool inTestMode();
+    /** Size of the captured frames, before cropping */
+    int frameWidth();
+    int frameHeight();
     int height, width;
     
 public slots:
     void start();
+    /** Stopping capture and releasing the camera, to be called on the thread
+     * the camera runs on; further calls do nothing */
+    void stop();
 
 private slots:
     void captureFrame();
@@ -55,6 +75,9 @@ private slots:
 signals:
     void newCamFrame(cv::Mat frame);
     void newCroppedFrame(cv::Mat frame);
+    /** Frames following do not continue the previous ones, emitted when a
+     * replay starts over and when switching between camera and test images */
+    void sequenceRestarted();
     void stopped();
 
 private:
@@ -66,9 +89,15 @@ private:
     dc1394error_t error;
 
     QTimer *eventLoopTimer;
+    bool isStopped;
     std::vector<cv::Mat> testImages;
     cv::Mat ambientImage;
     bool testMode;
+    FrameReader replay;
+    FrameRecorder *recorder;
+    int replayIdx;
+    PlaybackMode playbackMode;
+    double playbackRate;
     int imgIdx;
     int avgImgIntensity;
     int FRAME_RATE;
@@ -76,7 +105,7 @@ private:
     
     /* undistortion matrices */
     cv::Mat K, dist;
-    cv::Mat *map1LUT, *map2LUT;
+    FramePreprocessor *preprocessor;
 
     /* typedefs for writing in register */
     typedef strobe_cnt_reg<uint32_t> strobe_cnt_reg32;
@@ -86,13 +115,14 @@ private:
     typedef cam_ini_reg<uint32_t> cam_init_reg32;
 
     void captureAmbientImage();
+    /** Fetch next non-ambient record of the replayed session, returns its led
+     * index or -1 if the session holds no such record */
+    int nextReplayFrame(cv::Mat &frame, bool &undistorted);
     void resetCameraRegister();
     void startResetPulse();
     void stopResetPulse();
     void startClockPulse();
     void stopClockPulse();
-    void initUndistLUT();
-    void undistortLUT(cv::InputArray source, cv::OutputArray dest);
     /** Get the control register value of the camera at given offset */
     uint32_t readRegisterContent(uint64_t offset);
     /** Set control register value of camera at given offset to given value */
@@ -73,7 +73,15 @@ void CameraWidget::setup(cv::Mat& image) {
 
 void CameraWidget::setImage(cv::Mat image) {
 
+    TRACE_SCOPE("CameraWidget::setImage");
+
     importer->SetImportVoidPointer(image.data);
     importer->Modified();
     update();
 }
+
+void CameraWidget::paintEvent(QPaintEvent *event) {
+
+    TRACE_SCOPE("CameraWidget::paint");
+    QVTKWidget::paintEvent(event);
+}
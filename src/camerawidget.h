@@ -18,6 +18,8 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "trace.h"
+
 
 class CameraWidget : public QVTKWidget {
     Q_OBJECT
@@ -29,6 +31,10 @@ public:
 public slots:
     void setImage(cv::Mat image);
 
+protected:
+    /** vtk renders the scene when painting */
+    void paintEvent(QPaintEvent *event);
+
 private:
     /** vtk render window */
     vtkSmartPointer<vtkRenderWindow> renderWindow;
@@ -0,0 +1,152 @@
+#include "clprofiler.h"
+
+ClProfiler::ClProfiler() : frameTransfer(0), frames(0) {
+
+}
+
+cl::Event *ClProfiler::track(const char *name, CommandType type) {
+
+    /* events are pushed back only, their addresses stay valid until collected */
+    pending.push_back(Pending());
+    pending.back().name = name;
+    pending.back().type = type;
+    return &pending.back().event;
+}
+
+void ClProfiler::collect() {
+
+    while (!pending.empty()) {
+        Pending &p = pending.front();
+        cl_ulong queued = 0, submitted = 0, start = 0, end = 0;
+        bool ok = p.event.getProfilingInfo(CL_PROFILING_COMMAND_QUEUED, &queued) == CL_SUCCESS &&
+                  p.event.getProfilingInfo(CL_PROFILING_COMMAND_SUBMIT, &submitted) == CL_SUCCESS &&
+                  p.event.getProfilingInfo(CL_PROFILING_COMMAND_START, &start) == CL_SUCCESS &&
+                  p.event.getProfilingInfo(CL_PROFILING_COMMAND_END, &end) == CL_SUCCESS;
+        if (ok) {
+            /* device timestamps are in nanoseconds */
+            double submit = (submitted - queued) / 1000.0;
+            double wait = (start - submitted) / 1000.0;
+            double exec = (end - start) / 1000.0;
+            if (p.type == TRANSFER) {
+                frameTransfer += exec;
+            }
+            addSample(p.name, p.type, submit, wait, exec);
+        }
+        pending.pop_front();
+    }
+}
+
+long ClProfiler::endFrame() {
+
+    addSample("transfers per frame", TRANSFER, 0, 0, frameTransfer);
+    frameTransfer = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    return ++frames;
+}
+
+void ClProfiler::reset() {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.clear();
+    windows.clear();
+    order.clear();
+    frameTransfer = 0;
+    frames = 0;
+}
+
+void ClProfiler::addSample(const std::string &name, CommandType type, double submit, double wait, double exec) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, Window>::iterator it = windows.find(name);
+    if (it == windows.end()) {
+        it = windows.insert(std::make_pair(name, Window())).first;
+        it->second.type = type;
+        it->second.count = 0;
+        order.push_back(name);
+    }
+
+    Window &w = it->second;
+    w.count++;
+    w.submit.push_back(submit);
+    w.wait.push_back(wait);
+    w.exec.push_back(exec);
+    if (w.exec.size() > WINDOW_SIZE) {
+        w.submit.pop_front();
+        w.wait.pop_front();
+        w.exec.pop_front();
+    }
+}
+
+double ClProfiler::percentile(std::deque<double> values, double p) {
+
+    if (values.empty()) {
+        return 0;
+    }
+    size_t idx = std::min(values.size()-1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin()+idx, values.end());
+    return values[idx];
+}
+
+std::vector<ClProfiler::Stats> ClProfiler::statistics() {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Stats> stats;
+    for (size_t i=0; i<order.size(); i++) {
+        const Window &w = windows[order[i]];
+        Stats s;
+        s.name = order[i];
+        s.type = w.type;
+        s.count = w.count;
+        s.submitP50 = percentile(w.submit, 0.5);
+        s.waitP50 = percentile(w.wait, 0.5);
+        s.execP50 = percentile(w.exec, 0.5);
+        s.execP90 = percentile(w.exec, 0.9);
+        s.execP99 = percentile(w.exec, 0.99);
+        stats.push_back(s);
+    }
+    return stats;
+}
+
+std::string ClProfiler::summary() {
+
+    std::vector<Stats> stats = statistics();
+    std::stringstream s;
+    s.setf(std::ios::fixed);
+    s.precision(2);
+    for (size_t i=0; i<stats.size(); i++) {
+        if (stats[i].type == KERNEL || stats[i].name == "transfers per frame") {
+            s << (s.tellp() > 0 ? ", " : "") << stats[i].name << " " << stats[i].execP50/1000.0 << " ms";
+        }
+    }
+    return s.str();
+}
+
+bool ClProfiler::dump(const std::string &filename, const std::string &label) {
+
+    std::ofstream out(filename.c_str(), std::ios::app);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    std::vector<Stats> stats = statistics();
+    long numFrames;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        numFrames = frames;
+    }
+    out << "{\"engine\":\"" << label << "\",\"frames\":" << numFrames << ",\"unit\":\"us\",\"commands\":[";
+    for (size_t i=0; i<stats.size(); i++) {
+        out << (i > 0 ? "," : "")
+            << "{\"name\":\"" << stats[i].name << "\""
+            << ",\"type\":\"" << (stats[i].type == KERNEL ? "kernel" : "transfer") << "\""
+            << ",\"count\":" << stats[i].count
+            << ",\"submit_p50\":" << stats[i].submitP50
+            << ",\"wait_p50\":" << stats[i].waitP50
+            << ",\"exec_p50\":" << stats[i].execP50
+            << ",\"exec_p90\":" << stats[i].execP90
+            << ",\"exec_p99\":" << stats[i].execP99 << "}";
+    }
+    out << "]}" << std::endl;
+
+    return out.good();
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef CLPROFILER_H
+#define CLPROFILER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <stdint.h>
+
+#include "OpenCL/cl.hpp"
+
+/** Device side timing of OpenCL commands, requires a command queue created
+ * with CL_QUEUE_PROFILING_ENABLE. Commands are tracked by name and kept in a
+ * rolling window, from which percentiles are computed. */
+class ClProfiler {
+
+public:
+    enum CommandType { TRANSFER, KERNEL };
+
+    /** Percentiles of the rolling window of one command, in microseconds */
+    struct Stats {
+        std::string name;
+        CommandType type;
+        long count;
+        /** time from being queued until submitted to the device */
+        double submitP50;
+        /** time from being submitted until execution started, queueing on the device */
+        double waitP50;
+        /** execution time on the device */
+        double execP50, execP90, execP99;
+    };
+
+    static const size_t WINDOW_SIZE = 256;
+
+    ClProfiler();
+    /** Event the next command of given name is to be enqueued with */
+    cl::Event *track(const char *name, CommandType type);
+    /** Reading timestamps of all tracked events, their commands must have completed */
+    void collect();
+    /** Closing a reconstruction, summing up its transfers; returns the number of frames closed so far */
+    long endFrame();
+    void reset();
+
+    std::vector<Stats> statistics();
+    /** Median kernel and per frame transfer times for the status bar */
+    std::string summary();
+    /** Appending statistics as one json object per line, lines of later dumps supersede earlier ones */
+    bool dump(const std::string &filename, const std::string &label);
+
+private:
+    struct Pending {
+        const char *name;
+        CommandType type;
+        cl::Event event;
+    };
+    struct Window {
+        CommandType type;
+        long count;
+        std::deque<double> submit, wait, exec;
+    };
+
+    std::deque<Pending> pending;
+    std::map<std::string, Window> windows;
+    /* insertion order of commands, as they are executed */
+    std::vector<std::string> order;
+    double frameTransfer;
+    long frames;
+    std::mutex mutex;
+
+    void addSample(const std::string &name, CommandType type, double submit, double wait, double exec);
+    static double percentile(std::deque<double> values, double p);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,252 @@
+#include "framecontainer.h"
+
+const char FrameContainer::MAGIC[4] = { 'R', 'P', 'S', 'F' };
+
+uint32_t FrameContainer::recordSize(int width, int height) {
+
+    uint32_t size = sizeof(FrameRecordHeader) + width*height;
+    return (size + 63) & ~63u;
+}
+
+FrameReader::FrameReader() : data(NULL) {
+
+    memset(&header, 0, sizeof(header));
+}
+
+FrameReader::~FrameReader() {
+
+    close();
+}
+
+bool FrameReader::open(const QString &filename) {
+
+    close();
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "ERROR: Could not open recorded session " << filename.toStdString() << std::endl;
+        return false;
+    }
+
+    if (file.read((char*)&header, sizeof(header)) != sizeof(header) || memcmp(header.magic, FrameContainer::MAGIC, 4) != 0) {
+        std::cerr << "ERROR: " << filename.toStdString() << " is not a recorded session" << std::endl;
+        close();
+        return false;
+    }
+
+    if (header.version != FrameContainer::VERSION || header.recordSize != FrameContainer::recordSize(header.width, header.height)) {
+        std::cerr << "ERROR: Unsupported session format in " << filename.toStdString() << std::endl;
+        close();
+        return false;
+    }
+
+    /* recorder might have been killed before committing all slots, only trust what fits in the file */
+    qint64 available = (file.size() - (qint64)sizeof(header)) / header.recordSize;
+    if ((qint64)header.frameCount > available) {
+        header.frameCount = (uint32_t)available;
+    }
+    if (header.frameCount == 0) {
+        std::cerr << "ERROR: " << filename.toStdString() << " holds no frames" << std::endl;
+        close();
+        return false;
+    }
+
+    data = file.map(0, file.size());
+    if (data == NULL) {
+        std::cerr << "ERROR: Could not map recorded session into memory" << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void FrameReader::close() {
+
+    if (data != NULL) {
+        file.unmap(data);
+        data = NULL;
+    }
+    if (file.isOpen()) {
+        file.close();
+    }
+    memset(&header, 0, sizeof(header));
+}
+
+bool FrameReader::isOpen() const {
+
+    return data != NULL;
+}
+
+int FrameReader::width() const {
+
+    return header.width;
+}
+
+int FrameReader::height() const {
+
+    return header.height;
+}
+
+int FrameReader::frameCount() const {
+
+    return header.frameCount;
+}
+
+const FrameRecordHeader *FrameReader::record(int idx) const {
+
+    return (const FrameRecordHeader*)(data + sizeof(header) + (size_t)idx*header.recordSize);
+}
+
+cv::Mat FrameReader::frame(int idx) const {
+
+    uchar *pixels = (uchar*)record(idx) + sizeof(FrameRecordHeader);
+    return cv::Mat(header.height, header.width, CV_8UC1, pixels);
+}
+
+int FrameReader::ledIndex(int idx) const {
+
+    return record(idx)->ledIdx;
+}
+
+int64_t FrameReader::timestamp(int idx) const {
+
+    return record(idx)->timestamp;
+}
+
+bool FrameReader::isUndistorted(int idx) const {
+
+    return (record(idx)->flags & FRAME_FLAG_UNDISTORTED) != 0;
+}
+
+int FrameReader::ambientIndex() const {
+
+    for (int i=0; i<frameCount(); i++) {
+        if (ledIndex(i) == FRAME_LED_AMBIENT) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+FrameWriter::FrameWriter() : data(NULL), header(NULL), numFrames(0) {
+
+}
+
+FrameWriter::~FrameWriter() {
+
+    close();
+}
+
+bool FrameWriter::open(const QString &filename, int width, int height, int capacity) {
+
+    close();
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        std::cerr << "ERROR: Could not create recording " << filename.toStdString() << std::endl;
+        return false;
+    }
+
+    FrameContainerHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, FrameContainer::MAGIC, 4);
+    h.version = FrameContainer::VERSION;
+    h.width = width;
+    h.height = height;
+    h.frameCount = 0;
+    h.capacity = std::max(capacity, 1);
+    h.recordSize = FrameContainer::recordSize(width, height);
+
+    /* preallocate all slots upfront, appending then only touches mapped memory */
+    if (!file.resize(sizeof(h) + (qint64)h.capacity*h.recordSize) || !map()) {
+        std::cerr << "ERROR: Could not preallocate recording " << filename.toStdString() << std::endl;
+        close();
+        return false;
+    }
+    memcpy(header, &h, sizeof(h));
+    numFrames = 0;
+
+    return true;
+}
+
+bool FrameWriter::map() {
+
+    data = file.map(0, file.size());
+    header = (FrameContainerHeader*)data;
+    return data != NULL;
+}
+
+void FrameWriter::close() {
+
+    if (data != NULL) {
+        commit();
+        uint32_t used = numFrames, recordSize = header->recordSize;
+        header->capacity = used;
+        file.unmap(data);
+        data = NULL;
+        header = NULL;
+        file.resize(sizeof(FrameContainerHeader) + (qint64)used*recordSize);
+    }
+    if (file.isOpen()) {
+        file.close();
+    }
+    numFrames = 0;
+}
+
+bool FrameWriter::isOpen() const {
+
+    return data != NULL;
+}
+
+bool FrameWriter::grow() {
+
+    uint32_t capacity = header->capacity * 2;
+    qint64 size = sizeof(FrameContainerHeader) + (qint64)capacity*header->recordSize;
+
+    file.unmap(data);
+    data = NULL;
+    header = NULL;
+    if (!file.resize(size) || !map()) {
+        std::cerr << "ERROR: Could not grow recording to " << capacity << " frames" << std::endl;
+        return false;
+    }
+    header->capacity = capacity;
+
+    return true;
+}
+
+bool FrameWriter::append(const cv::Mat &frame, int ledIdx, uint32_t flags, int64_t timestamp) {
+
+    if (data == NULL || frame.cols != (int)header->width || frame.rows != (int)header->height || frame.type() != CV_8UC1) {
+        return false;
+    }
+    if (numFrames == header->capacity && !grow()) {
+        return false;
+    }
+
+    uchar *rec = data + sizeof(FrameContainerHeader) + (size_t)numFrames*header->recordSize;
+    FrameRecordHeader *recHeader = (FrameRecordHeader*)rec;
+    recHeader->ledIdx = ledIdx;
+    recHeader->flags = flags;
+    recHeader->timestamp = timestamp;
+
+    /* copying row-wise since frames might be sub-matrices */
+    uchar *pixels = rec + sizeof(FrameRecordHeader);
+    for (int y=0; y<frame.rows; y++) {
+        memcpy(pixels + y*frame.cols, frame.ptr<uchar>(y), frame.cols);
+    }
+    numFrames++;
+
+    return true;
+}
+
+void FrameWriter::commit() {
+
+    if (header != NULL) {
+        header->frameCount = numFrames;
+    }
+}
+
+int FrameWriter::frameCount() const {
+
+    return numFrames;
+}
@@ -0,0 +1,108 @@
+#ifndef FRAMECONTAINER_H
+#define FRAMECONTAINER_H
+
+#include <algorithm>
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+
+/* led index used for the ambient (no led) reference frame of a session */
+#define FRAME_LED_AMBIENT 0xFF
+
+/* record flag marking frames which already passed undistortion */
+#define FRAME_FLAG_UNDISTORTED 0x1
+
+/** File header of a recorded capture session. A session is a single file with
+ * this header followed by fixed-size records (record header + 8-bit pixels),
+ * so that records can be addressed directly through a memory map. */
+struct FrameContainerHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height;
+    /** number of committed records */
+    uint32_t frameCount;
+    /** number of preallocated record slots */
+    uint32_t capacity;
+    /** distance in bytes between two records */
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+/** Header in front of the pixel data of each record */
+struct FrameRecordHeader {
+    uint32_t ledIdx;
+    uint32_t flags;
+    /** capture time in microseconds since the start of the session */
+    int64_t timestamp;
+};
+
+class FrameContainer {
+
+public:
+    static const char MAGIC[4];
+    static const uint32_t VERSION = 1;
+    /** record size for given frame dimensions, padded to 64 byte boundaries */
+    static uint32_t recordSize(int width, int height);
+};
+
+/** Read-only access to a recorded session through a memory-mapped file */
+class FrameReader {
+
+public:
+    FrameReader();
+    ~FrameReader();
+    bool open(const QString &filename);
+    void close();
+    bool isOpen() const;
+    int width() const;
+    int height() const;
+    int frameCount() const;
+    /** frame at given record index, pointing into the mapped file (read-only!) */
+    cv::Mat frame(int idx) const;
+    int ledIndex(int idx) const;
+    int64_t timestamp(int idx) const;
+    bool isUndistorted(int idx) const;
+    /** index of the first ambient reference frame or -1 if none was recorded */
+    int ambientIndex() const;
+
+private:
+    QFile file;
+    uchar *data;
+    FrameContainerHeader header;
+
+    const FrameRecordHeader *record(int idx) const;
+};
+
+/** Append-only writer of recorded sessions. The file is preallocated and
+ * mapped into memory, records are copied into the map and published by
+ * updating the frame count in the header on commit(). */
+class FrameWriter {
+
+public:
+    FrameWriter();
+    ~FrameWriter();
+    bool open(const QString &filename, int width, int height, int capacity);
+    /** Closing file, truncating unused preallocated slots */
+    void close();
+    bool isOpen() const;
+    bool append(const cv::Mat &frame, int ledIdx, uint32_t flags, int64_t timestamp);
+    void commit();
+    int frameCount() const;
+
+private:
+    QFile file;
+    uchar *data;
+    FrameContainerHeader *header;
+    uint32_t numFrames;
+
+    /** Doubling preallocated capacity of a full file */
+    bool grow();
+    bool map();
+};
+
+#endif
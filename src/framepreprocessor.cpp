@@ -0,0 +1,64 @@
+#include "framepreprocessor.h"
+
+FramePreprocessor::FramePreprocessor(const cv::Mat &K, const cv::Mat &dist, int frameWidth, int frameHeight) : K(K), dist(dist), frameWidth(frameWidth), frameHeight(frameHeight) {
+
+    stripeSize = std::min(std::max(1, (1 << 12) / std::max(frameWidth, 1)), frameHeight);
+    initUndistLUT();
+}
+
+FramePreprocessor::~FramePreprocessor() {
+
+    delete[] map1LUT;
+    delete[] map2LUT;
+}
+
+void FramePreprocessor::initUndistLUT() {
+    
+    cv::Mat map1 = cv::Mat(stripeSize, frameWidth, CV_16SC2);
+    cv::Mat map2 = cv::Mat(stripeSize, frameWidth, CV_16UC1);
+    
+    map1LUT = new cv::Mat[frameHeight];
+    map2LUT = new cv::Mat[frameHeight];
+    
+    cv::Mat Ar;
+    K.convertTo(Ar, CV_64F);
+    
+    double v0 = K.at<double>(1,2);
+    for (int y = 0; y < frameHeight; y += stripeSize) {
+        int stripe = std::min(stripeSize, frameHeight - y);
+        Ar.at<double>(1,2) = v0 - y;
+        cv::Mat map1Part = map1.rowRange(0, stripe);
+        cv::Mat map2Part = map2.rowRange(0, stripe);
+        cv::initUndistortRectifyMap(K, dist, cv::noArray(), Ar, cv::Size(frameWidth, stripe), map1Part.type(), map1Part, map2Part);
+        map1LUT[y] = map1Part.clone();
+        map2LUT[y] = map2Part.clone();
+    }
+}
+
+void FramePreprocessor::undistort(cv::InputArray source, cv::OutputArray dest) {
+    
+    cv::Mat src = source.getMat();
+    dest.create(src.size(), src.type());
+    cv::Mat dst = dest.getMat();
+    
+    for (int y = 0; y < src.rows; y += stripeSize) {
+        int stripe = std::min(stripeSize, src.rows - y);
+        cv::Mat map1Part = map1LUT[y];
+        cv::Mat map2Part = map2LUT[y];
+        cv::Mat destPart = dst.rowRange(y, y + stripe);
+        cv::remap(src, destPart, map1Part, map2Part, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    }
+}
+
+cv::Rect FramePreprocessor::cropRect(const cv::Mat &frame, int size) {
+
+    return cv::Rect((frame.cols-size)/2, (frame.rows-size)/2, size, size);
+}
+
+cv::Mat FramePreprocessor::removeAmbient(const cv::Mat &frame, const cv::Mat &ambient, int size) {
+
+    cv::Rect cropped = cropRect(frame, size);
+    cv::Mat croppedFrame;
+    cv::subtract(frame(cropped), ambient(cropped), croppedFrame);
+    return croppedFrame;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef FRAMEPREPROCESSOR_H
+#define FRAMEPREPROCESSOR_H
+
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+/** Preparing raw camera frames for reconstruction: lens undistortion through
+ * precomputed lookup tables, ambient light removal and center cropping */
+class FramePreprocessor {
+
+public:
+    /** K camera matrix, dist distortion coefficients of the lens */
+    FramePreprocessor(const cv::Mat &K, const cv::Mat &dist, int frameWidth, int frameHeight);
+    ~FramePreprocessor();
+    void undistort(cv::InputArray source, cv::OutputArray dest);
+    /** Centered square of given size */
+    static cv::Rect cropRect(const cv::Mat &frame, int size);
+    /** Subtracting ambient image within the centered square of given size */
+    static cv::Mat removeAmbient(const cv::Mat &frame, const cv::Mat &ambient, int size);
+
+private:
+    cv::Mat K, dist;
+    int frameWidth, frameHeight;
+    int stripeSize;
+    cv::Mat *map1LUT, *map2LUT;
+
+    void initUndistLUT();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "framerecorder.h"
+
+FrameRecorder::FrameRecorder(QObject *parent) : QThread(parent), recording(false), undistorted(false), ambientRecorded(false), numDropped(0) {
+
+}
+
+FrameRecorder::~FrameRecorder() {
+
+    close();
+}
+
+bool FrameRecorder::open(const QString &filename, int width, int height, bool undistorted, int preallocFrames) {
+
+    close();
+
+    /* the writer is only used by the recorder thread once it is started */
+    if (!writer.open(filename, width, height, preallocFrames)) {
+        return false;
+    }
+
+    mutex.lock();
+    this->undistorted = undistorted;
+    ambientRecorded = false;
+    numDropped = 0;
+    queue.clear();
+    clock.start();
+    recording = true;
+    mutex.unlock();
+
+    start(QThread::LowPriority);
+    return true;
+}
+
+void FrameRecorder::close() {
+
+    mutex.lock();
+    recording = false;
+    frameQueued.wakeAll();
+    mutex.unlock();
+
+    wait();
+}
+
+bool FrameRecorder::isRecording() {
+
+    QMutexLocker locker(&mutex);
+    return recording;
+}
+
+bool FrameRecorder::recordsUndistorted() {
+
+    QMutexLocker locker(&mutex);
+    return undistorted;
+}
+
+bool FrameRecorder::hasAmbient() {
+
+    QMutexLocker locker(&mutex);
+    return ambientRecorded;
+}
+
+int FrameRecorder::droppedFrames() {
+
+    QMutexLocker locker(&mutex);
+    return numDropped;
+}
+
+int64_t FrameRecorder::timestamp() {
+
+    QMutexLocker locker(&mutex);
+    return clock.nsecsElapsed() / 1000;
+}
+
+void FrameRecorder::append(const cv::Mat &frame, int ledIdx, int64_t timestamp) {
+
+    QMutexLocker locker(&mutex);
+    if (!recording) {
+        return;
+    }
+
+    /* never block the camera thread, dropping frames if the disk can not keep up */
+    if (queue.size() >= MAX_QUEUED) {
+        numDropped++;
+        return;
+    }
+
+    Entry e;
+    e.frame = frame;
+    e.ledIdx = ledIdx;
+    e.timestamp = timestamp;
+    queue.append(e);
+
+    if (ledIdx == FRAME_LED_AMBIENT) {
+        ambientRecorded = true;
+    }
+    if (queue.size() >= BATCH_SIZE) {
+        frameQueued.wakeOne();
+    }
+}
+
+void FrameRecorder::run() {
+
+    uint32_t flags = 0;
+    bool active = true;
+
+    while (active) {
+        /* waiting for a complete batch, flushing at least every 100 ms */
+        QList<Entry> batch;
+        mutex.lock();
+        if (recording && queue.size() < BATCH_SIZE) {
+            frameQueued.wait(&mutex, 100);
+        }
+        batch.swap(queue);
+        active = recording;
+        flags = undistorted ? FRAME_FLAG_UNDISTORTED : 0;
+        mutex.unlock();
+
+        for (int i=0; i<batch.size(); i++) {
+            const Entry &e = batch.at(i);
+            /* ambient reference is always recorded as captured */
+            if (!writer.append(e.frame, e.ledIdx, (e.ledIdx == FRAME_LED_AMBIENT) ? 0 : flags, e.timestamp)) {
+                std::cerr << "ERROR: Could not write frame, recording stopped" << std::endl;
+                mutex.lock();
+                recording = false;
+                mutex.unlock();
+                active = false;
+                break;
+            }
+        }
+        writer.commit();
+    }
+
+    int numFrames = writer.frameCount();
+    writer.close();
+    emit recordingStopped(numFrames, droppedFrames());
+}
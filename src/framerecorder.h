@@ -0,0 +1,66 @@
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+#include <opencv2/core/core.hpp>
+
+#include <QtCore/QThread>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include "framecontainer.h"
+
+/** Recording camera frames into a session file. Frames are only queued by the
+ * camera thread, copying them into the memory-mapped file happens in batches
+ * on the recorder thread. */
+class FrameRecorder : public QThread {
+
+    Q_OBJECT
+
+public:
+    FrameRecorder(QObject *parent = 0);
+    ~FrameRecorder();
+    /** Start recording frames of given size into given file, frames are
+     * preallocated for one minute at 15 fps; false if the file can not be created */
+    bool open(const QString &filename, int width, int height, bool undistorted, int preallocFrames = 15*60);
+    /** Stop recording, flushing all queued frames */
+    void close();
+    bool isRecording();
+    bool recordsUndistorted();
+    bool hasAmbient();
+    /** Microseconds since recording started, for stamping frames when captured */
+    int64_t timestamp();
+    /** Queue frame captured at given timestamp for recording, frame data must
+     * not be modified afterwards */
+    void append(const cv::Mat &frame, int ledIdx, int64_t timestamp);
+    int droppedFrames();
+
+signals:
+    void recordingStopped(int numFrames, int numDropped);
+
+protected:
+    void run();
+
+private:
+    struct Entry {
+        cv::Mat frame;
+        int ledIdx;
+        int64_t timestamp;
+    };
+
+    FrameWriter writer;
+    QMutex mutex;
+    QWaitCondition frameQueued;
+    QList<Entry> queue;
+    QElapsedTimer clock;
+    bool recording, undistorted, ambientRecorded;
+    int numDropped;
+
+    /* frames written at once and upper limit of frames waiting for the recorder thread */
+    static const int BATCH_SIZE = 8;
+    static const int MAX_QUEUED = 256;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "imagewriter.h"
+
+/* tiff field types */
+#define TIFF_SHORT 3
+#define TIFF_LONG 4
+
+const double ImageWriter::ALBEDO_SCALE = 64.0;
+
+bool ImageWriter::formatOf(const std::string &filename, Format &format) {
+
+    size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = filename.substr(dot+1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    if (ext == "png") {
+        format = PNG;
+    } else if (ext == "tif" || ext == "tiff") {
+        format = TIFF_FLOAT;
+    } else if (ext == "exr") {
+        format = EXR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *ImageWriter::extension(Format format) {
+
+    switch (format) {
+        case PNG:
+        case PNG16:
+            return "png";
+        case TIFF_FLOAT:
+            return "tif";
+        default:
+            return "exr";
+    }
+}
+
+bool ImageWriter::writeDepth(const std::string &filename, const cv::Mat &Z, Format format) {
+
+    if (Z.empty()) {
+        return false;
+    }
+
+    switch (format) {
+        case PNG:
+        case PNG16: {
+            /* depth map scaled to full 16-bit range */
+            cv::Mat depth;
+            cv::normalize(Z, depth, 0, 65535, cv::NORM_MINMAX, CV_16U);
+            return cv::imwrite(filename, depth);
+        }
+        case TIFF_FLOAT:
+            return writeFloatTIFF(filename, Z);
+        default:
+            return cv::imwrite(filename, Z);
+    }
+}
+
+bool ImageWriter::writeNormals(const std::string &filename, const cv::Mat &Normals, Format format) {
+
+    if (Normals.empty()) {
+        return false;
+    }
+
+    /* tiff is written as rgb, OpenCV writes bgr */
+    if (format == TIFF_FLOAT) {
+        return writeFloatTIFF(filename, Normals);
+    }
+    cv::Mat normals;
+    if (format == PNG) {
+        Normals.convertTo(normals, CV_8UC3, 127.5, 127.5);
+    } else if (format == PNG16) {
+        Normals.convertTo(normals, CV_16UC3, 32767.5, 32767.5);
+    } else {
+        normals = Normals;
+    }
+    cv::cvtColor(normals, normals, CV_RGB2BGR);
+    return cv::imwrite(filename, normals);
+}
+
+bool ImageWriter::writeAlbedo(const std::string &filename, const cv::Mat &Albedo, Format format) {
+
+    if (Albedo.empty()) {
+        return false;
+    }
+
+    switch (format) {
+        case PNG:
+        case PNG16: {
+            /* one scale for all images keeps them comparable within a sequence */
+            cv::Mat albedo;
+            Albedo.convertTo(albedo, CV_16U, ALBEDO_SCALE);
+            return cv::imwrite(filename, albedo);
+        }
+        case TIFF_FLOAT:
+            return writeFloatTIFF(filename, Albedo);
+        default:
+            return cv::imwrite(filename, Albedo);
+    }
+}
+
+bool ImageWriter::writeFloatTIFF(const std::string &filename, const cv::Mat &img) {
+
+    int channels = img.channels();
+    if (img.depth() != CV_32F || (channels != 1 && channels != 3)) {
+        return false;
+    }
+
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out) {
+        return false;
+    }
+
+    /* header, one directory of 11 entries, per channel bits and sample formats, pixels */
+    const uint16_t numTags = 11;
+    uint32_t ifdOffset = 8;
+    uint32_t extraOffset = ifdOffset + 2 + numTags*12 + 4;
+    uint32_t dataOffset = extraOffset + (channels > 1 ? 2*channels*sizeof(uint16_t) : 0);
+    uint32_t rowSize = img.cols * channels * sizeof(float);
+
+    out.write("II*\0", 4);
+    out.write((const char*)&ifdOffset, 4);
+
+    /* values of more than one short do not fit the entry and are stored after the directory */
+    uint32_t bits = (channels > 1) ? extraOffset : 32;
+    uint32_t sampleFormats = (channels > 1) ? extraOffset + channels*sizeof(uint16_t) : 3;
+
+    out.write((const char*)&numTags, 2);
+    writeTag(out, 256, TIFF_LONG, 1, img.cols);
+    writeTag(out, 257, TIFF_LONG, 1, img.rows);
+    writeTag(out, 258, TIFF_SHORT, channels, bits);
+    /* no compression */
+    writeTag(out, 259, TIFF_SHORT, 1, 1);
+    /* black is zero or rgb */
+    writeTag(out, 262, TIFF_SHORT, 1, (channels > 1) ? 2 : 1);
+    writeTag(out, 273, TIFF_LONG, 1, dataOffset);
+    writeTag(out, 277, TIFF_SHORT, 1, channels);
+    writeTag(out, 278, TIFF_LONG, 1, img.rows);
+    writeTag(out, 279, TIFF_LONG, 1, rowSize*img.rows);
+    /* interleaved channels */
+    writeTag(out, 284, TIFF_SHORT, 1, 1);
+    /* ieee floating point */
+    writeTag(out, 339, TIFF_SHORT, channels, sampleFormats);
+    uint32_t nextIfd = 0;
+    out.write((const char*)&nextIfd, 4);
+
+    if (channels > 1) {
+        std::vector<uint16_t> extra(channels, 32);
+        extra.resize(2*channels, 3);
+        out.write((const char*)extra.data(), extra.size()*sizeof(uint16_t));
+    }
+
+    for (int i=0; i<img.rows; i++) {
+        out.write((const char*)img.ptr<float>(i), rowSize);
+    }
+
+    return out.good();
+}
+
+void ImageWriter::writeTag(std::ofstream &out, uint16_t tag, uint16_t type, uint32_t count, uint32_t value) {
+
+    out.write((const char*)&tag, 2);
+    out.write((const char*)&type, 2);
+    out.write((const char*)&count, 4);
+    /* single shorts are left-justified in the value field, which is little endian here */
+    out.write((const char*)&value, 4);
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <stdint.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+/** Writers of depth, normal and albedo maps as images, a fraction of the size
+ * of a mesh of the same model. PNGs are quantized (depth scaled to the full
+ * 16-bit range, normals as (n+1)/2 in 8 bit, or 16 bit with PNG16), TIFF and
+ * OpenEXR keep the float values. */
+class ImageWriter {
+
+public:
+    enum Format {PNG, PNG16, TIFF_FLOAT, EXR};
+
+    /** Format matching the extension of filename (png, tif/tiff, exr), false if
+     * none does; PNG16 is never chosen by extension */
+    static bool formatOf(const std::string &filename, Format &format);
+    static const char *extension(Format format);
+
+    static bool writeDepth(const std::string &filename, const cv::Mat &Z, Format format);
+    static bool writeNormals(const std::string &filename, const cv::Mat &Normals, Format format);
+    /** Albedo in intensity units times ALBEDO_SCALE in 16-bit PNGs, saturating
+     * above, as float otherwise */
+    static bool writeAlbedo(const std::string &filename, const cv::Mat &Albedo, Format format);
+    /** Fixed-point scale of albedo PNGs, the same for every image: steps of 1/64
+     * intensity unit up to 1023.98, four times the brightest 8-bit intensity, as
+     * albedo exceeds the intensities where the surface faces away from the lights */
+    static const double ALBEDO_SCALE;
+
+private:
+    /** Uncompressed single strip TIFF of one or three float channels, written
+     * directly since OpenCV only encodes 8 and 16-bit TIFFs */
+    static bool writeFloatTIFF(const std::string &filename, const cv::Mat &img);
+    static void writeTag(std::ofstream &out, uint16_t tag, uint16_t type, uint32_t count, uint32_t value);
+};
+
+#endif
\ No newline at end of file
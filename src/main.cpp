@@ -1,29 +1,110 @@
 #include <QApplication>
 #include <iostream>
+#include <string.h>
 #include "calibration.h"
 #include "utils.h"
 #include "mainwindow.h"
+#include "multicamera.h"
+#include "batch.h"
+#include "trace.h"
 
 int main(int argc, char* argv[])
 {
-    QApplication app(argc, argv);
+    /* headless modes must not require a display */
+    bool headless = false;
+    for (int i=1; i<argc; i++) {
+        if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--multi") == 0 ||
+            strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--batch") == 0) {
+            headless = true;
+        }
+    }
+    QApplication app(argc, argv, !headless);
     
     QStringList args = app.arguments();
     
+    /* tracing hot paths, written to file when the application exits */
+    int traceArg = args.indexOf("--trace");
+    if (traceArg != -1 && traceArg+1 < args.size()) {
+        Trace::setEnabled(true);
+        Trace::setThreadName("Main");
+        Trace::dumpAtExit(args.at(traceArg+1).toStdString());
+    }
+    
+    /* opencl device timings, appended to file by each engine when destroyed */
+    int profileArg = args.indexOf("--profile-cl");
+    if (profileArg != -1) {
+        bool hasFile = profileArg+1 < args.size() && !args.at(profileArg+1).startsWith("-");
+        ReconstructionEngine::setDefaultProfiling(true, hasFile ? args.at(profileArg+1).toStdString() : std::string());
+    }
+    
     /* parsing command line arguments */
     if (args.contains("-c") || args.contains("--calibrate")) {
         Calibration::withFourPlanes();
         return 0;
     } else if (args.contains("-d") || args.contains("--debug")) {
         return Utils::diplayLightDirections();
+    } else if (args.contains("-b") || args.contains("--batch")) {
+        int batchArg = std::max(args.indexOf("-b"), args.indexOf("--batch"));
+        int outputArg = std::max(args.indexOf("-o"), args.indexOf("--output"));
+        if (batchArg+1 >= args.size()) {
+            std::cerr << "Missing input directory." << std::endl;
+            return 1;
+        }
+        QString outputDir = (outputArg != -1 && outputArg+1 < args.size()) ? args.at(outputArg+1) : QString("reconstructions");
+        bool albedo = args.contains("-a") || args.contains("--albedo");
+        /* image format given by its extension, png16 for 16-bit normal maps */
+        ImageWriter::Format format = ImageWriter::PNG;
+        int formatArg = args.indexOf("--format");
+        if (formatArg != -1 && formatArg+1 < args.size() && args.at(formatArg+1) == "png16") {
+            format = ImageWriter::PNG16;
+        } else if (formatArg != -1 && (formatArg+1 >= args.size() || !ImageWriter::formatOf("." + args.at(formatArg+1).toStdString(), format))) {
+            std::cerr << "Unknown image format, use png, png16, tiff or exr." << std::endl;
+            return 1;
+        }
+        return (Batch::run(args.at(batchArg+1), outputDir, albedo, format) == 0) ? 0 : 1;
+    } else if (headless) {
+        /* optional number of stations following the option */
+        int multiArg = std::max(args.indexOf("-m"), args.indexOf("--multi"));
+        bool ok = false;
+        int numStations = (multiArg+1 < args.size()) ? args.at(multiArg+1).toInt(&ok) : -1;
+        MultiCamera stations;
+        if (stations.open(ok ? numStations : -1) < 1) {
+            std::cerr << "No stations to run." << std::endl;
+            return 1;
+        }
+        stations.start();
+        return app.exec();
     } else if (args.contains("-h") || args.contains("--help")) {
         std::cout << "Usage: " << args.at(0).toStdString() << " [OPTIONS]" << std::endl;
         std::cout << "\t-c, --calibrate\tcalibrating with four planes" << std::endl;
         std::cout << "\t-d, --debug\tdisplaying light source directions" << std::endl;
+        std::cout << "\t-r, --replay FILE\treplaying a recorded session instead of using the camera" << std::endl;
+        std::cout << "\t-b, --batch DIR\theadless reconstruction of all image sets below DIR" << std::endl;
+        std::cout << "\t-o, --output DIR\twriting depth and normal maps of batch mode to DIR (default: reconstructions)" << std::endl;
+        std::cout << "\t-a, --albedo\twriting albedo maps in batch mode as well" << std::endl;
+        std::cout << "\t--format png|png16|tiff|exr\timage format of batch mode, png with 8-bit normals, png16 with 16-bit normals or float tiff/exr (default: png)" << std::endl;
+        std::cout << "\t-m, --multi [N]\theadless capture and reconstruction with N stations (default: all cameras)" << std::endl;
+        std::cout << "\t--trace FILE\twriting a chrome trace of the hot paths to FILE on exit" << std::endl;
+        std::cout << "\t--profile-cl [FILE]\tshowing opencl device timings, appending percentiles as json lines to FILE every 100 sets and on exit" << std::endl;
+        std::cout << "\t--fps N\treplaying with fixed N frames/s, 0 as fast as possible (default: recorded timing)" << std::endl;
         return 0;
     } 
     
-    MainWindow mainWin;
+    /* replaying recorded sessions */
+    QString replayFile;
+    Camera::PlaybackMode playbackMode = Camera::REALTIME;
+    double playbackRate = 15.0;
+    int replayArg = std::max(args.indexOf("-r"), args.indexOf("--replay"));
+    if (replayArg != -1 && replayArg+1 < args.size()) {
+        replayFile = args.at(replayArg+1);
+    }
+    int fpsArg = args.indexOf("--fps");
+    if (fpsArg != -1 && fpsArg+1 < args.size()) {
+        playbackRate = args.at(fpsArg+1).toDouble();
+        playbackMode = (playbackRate > 0) ? Camera::FIXED_RATE : Camera::AS_FAST_AS_POSSIBLE;
+    }
+    
+    MainWindow mainWin(0, replayFile, playbackMode, playbackRate);
     mainWin.show();
     return app.exec();
 }
@@ -1,6 +1,6 @@
 #include "mainwindow.h"
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
+MainWindow::MainWindow(QWidget *parent, const QString &replayFile, Camera::PlaybackMode playbackMode, double playbackRate) : QMainWindow(parent), modelStale(false), normalsStale(false), awaitingPaint(false) {
 
     /* register several types in order to use it for qt signals/slots */
     qRegisterMetaType<cv::Mat>("cv::Mat");
@@ -8,8 +8,10 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 
     /* setup camera */
     camera = new Camera();
-    bool camFound = camera->open(0);
-    if (!camFound) {
+    if (!replayFile.isEmpty() && camera->openReplay(replayFile)) {
+        /* replaying a recorded session instead of using the camera */
+        camera->setPlaybackMode(playbackMode, playbackRate);
+    } else if (!camera->open(0)) {
         /* no camera, forcing test mode */
         camera->setTestMode(true);
     } else {
@@ -18,11 +20,25 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
         camera->printStatus();
     }
     
+    /* recorder is idle until recording is started from the ui */
+    recorder = new FrameRecorder(this);
+    camera->setRecorder(recorder);
+    connect(recorder, SIGNAL(recordingStopped(int, int)), this, SLOT(onRecordingStopped(int, int)));
+
     camThread = new QThread;
     camera->moveToThread(camThread);
         
     /* creating photometric stereo process */
     ps = new PhotometricStereo(camera->width, camera->height, camera->avgImageIntensity());
+    /* never running two reconstructions of the same process at once */
+    scheduler = new ReconstructionScheduler;
+    ps->setScheduler(scheduler);
+    scheduler->addStation(ps, "Camera");
+
+    /* every finished model is handed to the model recorder directly, it only queues it */
+    modelRecorder = new ModelRecorder(this);
+    connect(ps, SIGNAL(modelFinished(std::vector<cv::Mat>)), modelRecorder, SLOT(append(std::vector<cv::Mat>)), Qt::DirectConnection);
+    connect(modelRecorder, SIGNAL(recordingStopped(int, int)), this, SLOT(onModelRecordingStopped(int, int)));
 
     /* setup ui */
     setWindowTitle("Realtime Photometric-Stereo");
@@ -39,10 +55,14 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     connect(camera, SIGNAL(newCamFrame(cv::Mat)), camWidget, SLOT(setImage(cv::Mat)), Qt::AutoConnection);
     /* invoking ps setImage slot immediately, when the signal is emitted to ensure image order */
     connect(camera, SIGNAL(newCroppedFrame(cv::Mat)), ps, SLOT(setImage(cv::Mat)), Qt::DirectConnection);
+    connect(camera, SIGNAL(sequenceRestarted()), ps, SLOT(restartSequence()), Qt::DirectConnection);
     
-    /* connecting ps process with mainwindow and modelwidget */
-    connect(ps, SIGNAL(executionTime(QString)), this, SLOT(setStatusMessage(QString)), Qt::AutoConnection);
-    connect(ps, SIGNAL(modelFinished(std::vector<cv::Mat>)), this, SLOT(onModelFinished(std::vector<cv::Mat>)), Qt::AutoConnection);
+    /* connecting ps process with mainwindow, models are taken from its mailbox
+       once the views painted the previous one, models finished in between are
+       skipped; an idle mainwindow is woken up by the next model */
+    connect(ps, SIGNAL(modelAvailable()), this, SLOT(onModelAvailable()), Qt::AutoConnection);
+    connect(modelWidget, SIGNAL(painted()), this, SLOT(onViewPainted()));
+    connect(normalsWidget, SIGNAL(painted()), this, SLOT(onViewPainted()));
     
     /* start camera in separate thread with high priority */
     camThread->start();
@@ -52,11 +72,15 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 MainWindow::~MainWindow() {
 
     /* cleaning up */
-    if (!camera->inTestMode()) {
-        camera->stop();
+    recorder->close();
+    modelRecorder->close();
+    if (!camera->inTestMode() && !camera->inReplayMode()) {
+        /* stopped on the capture thread, which might be capturing a frame right now */
+        QMetaObject::invokeMethod(camera, "stop", Qt::BlockingQueuedConnection);
     }
     camThread->quit();
     
+    delete scheduler;
     delete ps;
     delete camThread;
     delete camWidget;
@@ -108,7 +132,10 @@ void MainWindow::createInterface() {
     /* test modus using 8 prev taken photos */
     testModeCheckBox = new QCheckBox("Test/Presentation mode");
     connect(testModeCheckBox, SIGNAL(stateChanged(int)), this, SLOT(onTestModeChecked(int)));
-    if (camera->inTestMode()) {
+    if (camera->inReplayMode()) {
+        /* replayed sessions are independent of test images */
+        testModeCheckBox->setDisabled(true);
+    } else if (camera->inTestMode()) {
         /* no camera found, forcing test mode */
         testModeCheckBox->setChecked(true);
         testModeCheckBox->setDisabled(true);
@@ -124,8 +151,28 @@ void MainWindow::createInterface() {
     /* export 3d model button */
     exportButton = new QPushButton("Export 3D Model", centralWidget);
     connect(exportButton, SIGNAL(clicked()), modelWidget, SLOT(exportModel()));
+    connect(modelWidget->getExporter(), SIGNAL(progress(int)), this, SLOT(onExportProgress(int)));
+    connect(modelWidget->getExporter(), SIGNAL(finished(QString, bool)), this, SLOT(onExportFinished(QString, bool)));
     gridLayout->addWidget(exportButton, 2, 1);
 
+    /* recording camera frames for later replay, and reconstructed models */
+    recordLayout = new QHBoxLayout();
+    recordButton = new QPushButton("Record frames", centralWidget);
+    recordButton->setCheckable(true);
+    connect(recordButton, SIGNAL(toggled(bool)), this, SLOT(onRecordToggled(bool)));
+    recordLayout->addWidget(recordButton);
+    rawFramesCheckBox = new QCheckBox("Raw frames", centralWidget);
+    rawFramesCheckBox->setToolTip("Recording frames as captured instead of undistorted");
+    recordLayout->addWidget(rawFramesCheckBox);
+    recordModelsButton = new QPushButton("Record models", centralWidget);
+    recordModelsButton->setCheckable(true);
+    connect(recordModelsButton, SIGNAL(toggled(bool)), this, SLOT(onRecordModelsToggled(bool)));
+    recordLayout->addWidget(recordModelsButton);
+    floatDepthCheckBox = new QCheckBox("Float depth", centralWidget);
+    floatDepthCheckBox->setToolTip("Recording heights as float instead of quantized to 16 bit");
+    recordLayout->addWidget(floatDepthCheckBox);
+    gridLayout->addLayout(recordLayout, 3, 1, Qt::AlignTop);
+
     /* add settings to adjust ps parameter and export 3d model */
     paramsGroupBox = new QGroupBox("PS parameters", centralWidget);
     paramsLayout = new QGridLayout(paramsGroupBox);
@@ -172,6 +219,70 @@ void MainWindow::createInterface() {
     paramsLayout->addWidget(unsharpNormsLabel, 4, 0);
     paramsLayout->addWidget(unsharpNormSlider, 4, 1);
     
+    unsharpRadiusLabel = new QLabel("Unsharp masking radius", paramsGroupBox);
+    unsharpRadiusSlider = new QSlider(Qt::Horizontal, paramsGroupBox);
+    unsharpRadiusSlider->setRange(1, 32);
+    unsharpRadiusSlider->setValue(ps->getUnsharpRadius());
+    connect(unsharpRadiusSlider, SIGNAL(valueChanged(int)), ps, SLOT(setUnsharpRadius(int)));
+    paramsLayout->addWidget(unsharpRadiusLabel, 5, 0);
+    paramsLayout->addWidget(unsharpRadiusSlider, 5, 1);
+    
+    fastMathCheckBox = new QCheckBox("Fast relaxed math", paramsGroupBox);
+    fastMathCheckBox->setChecked(ps->getFastMath());
+    connect(fastMathCheckBox, SIGNAL(toggled(bool)), ps, SLOT(setFastMath(bool)));
+    paramsLayout->addWidget(fastMathCheckBox, 6, 1);
+    
+    halfStorageCheckBox = new QCheckBox("Half precision storage", paramsGroupBox);
+    halfStorageCheckBox->setChecked(ps->getHalfStorage());
+    connect(halfStorageCheckBox, SIGNAL(toggled(bool)), ps, SLOT(setHalfStorage(bool)));
+    paramsLayout->addWidget(halfStorageCheckBox, 7, 1);
+    
+    albedoCheckBox = new QCheckBox("Compute albedo", paramsGroupBox);
+    albedoCheckBox->setChecked(ps->getAlbedo());
+    connect(albedoCheckBox, SIGNAL(toggled(bool)), ps, SLOT(setAlbedo(bool)));
+    paramsLayout->addWidget(albedoCheckBox, 8, 1);
+    
+    robustCheckBox = new QCheckBox("Ignore single shadows and highlights", paramsGroupBox);
+    robustCheckBox->setChecked(ps->getRobust());
+    connect(robustCheckBox, SIGNAL(toggled(bool)), ps, SLOT(setRobust(bool)));
+    paramsLayout->addWidget(robustCheckBox, 9, 1);
+    
+    maxIntensLabel = new QLabel("Set highlight intensity", paramsGroupBox);
+    maxIntensSlider = new QSlider(Qt::Horizontal, paramsGroupBox);
+    maxIntensSlider->setRange(1, 255);
+    maxIntensSlider->setValue(ps->getMaxIntensity());
+    connect(maxIntensSlider, SIGNAL(valueChanged(int)), ps, SLOT(setMaxIntensity(int)));
+    paramsLayout->addWidget(maxIntensLabel, 10, 0);
+    paramsLayout->addWidget(maxIntensSlider, 10, 1);
+    
+    foregroundCheckBox = new QCheckBox("Skip background tiles", paramsGroupBox);
+    foregroundCheckBox->setChecked(ps->getForegroundOnly());
+    connect(foregroundCheckBox, SIGNAL(toggled(bool)), ps, SLOT(setForegroundOnly(bool)));
+    paramsLayout->addWidget(foregroundCheckBox, 11, 1);
+    
+    lodCheckBox = new QCheckBox("Decimate live model", paramsGroupBox);
+    lodCheckBox->setChecked(true);
+    connect(lodCheckBox, SIGNAL(toggled(bool)), modelWidget, SLOT(setLevelOfDetail(bool)));
+    paramsLayout->addWidget(lodCheckBox, 12, 1);
+    
+    temporalCheckBox = new QCheckBox("Temporal filtering", paramsGroupBox);
+    temporalCheckBox->setChecked(ps->getTemporalFilter());
+    connect(temporalCheckBox, SIGNAL(toggled(bool)), ps, SLOT(setTemporalFilter(bool)));
+    paramsLayout->addWidget(temporalCheckBox, 13, 1);
+    
+    temporalSigmaLabel = new QLabel("Temporal noise", paramsGroupBox);
+    temporalSigmaSlider = new QSlider(Qt::Horizontal, paramsGroupBox);
+    temporalSigmaSlider->setRange(1, 100);
+    temporalSigmaSlider->setValue((int)(ps->getTemporalSigma()*1000));
+    connect(temporalSigmaSlider, SIGNAL(valueChanged(int)), ps, SLOT(setTemporalSigma(int)));
+    paramsLayout->addWidget(temporalSigmaLabel, 14, 0);
+    paramsLayout->addWidget(temporalSigmaSlider, 14, 1);
+    
+    motionCheckBox = new QCheckBox("Compensate motion between images", paramsGroupBox);
+    motionCheckBox->setChecked(ps->getMotionCompensation());
+    connect(motionCheckBox, SIGNAL(toggled(bool)), ps, SLOT(setMotionCompensation(bool)));
+    paramsLayout->addWidget(motionCheckBox, 15, 1);
+    
     paramsGroupBox->setLayout(paramsLayout);
     paramsGroupBox->hide();
     gridLayout->addWidget(paramsGroupBox, 3, 0);
@@ -185,6 +296,72 @@ void MainWindow::onToggleSettingsMenu() {
     paramsGroupBox->setVisible(toggleSettingsButton->isChecked());
 }
 
+void MainWindow::onRecordToggled(bool checked) {
+
+    if (!checked) {
+        recorder->close();
+        recordButton->setText("Record frames");
+        rawFramesCheckBox->setEnabled(true);
+        return;
+    }
+
+    QString filename = QFileDialog::getSaveFileName(this, "Record frames", "", "Recorded session (*.rps)");
+    if (filename.isEmpty()) {
+        recordButton->setChecked(false);
+        return;
+    }
+
+    if (!recorder->open(filename, camera->frameWidth(), camera->frameHeight(), !rawFramesCheckBox->isChecked())) {
+        statusBar()->showMessage("ERROR: Could not create " + filename);
+        recordButton->setChecked(false);
+        return;
+    }
+    rawFramesCheckBox->setEnabled(false);
+    recordButton->setText("Stop recording");
+}
+
+void MainWindow::onRecordingStopped(int numFrames, int numDropped) {
+
+    /* recording also stops by itself if writing fails */
+    if (!recorder->isRecording()) {
+        recordButton->setChecked(false);
+    }
+    setStatusMessage(QString("Recorded %1 frames (%2 dropped).").arg(numFrames).arg(numDropped));
+}
+
+void MainWindow::onRecordModelsToggled(bool checked) {
+
+    if (!checked) {
+        modelRecorder->close();
+        recordModelsButton->setText("Record models");
+        floatDepthCheckBox->setEnabled(true);
+        return;
+    }
+
+    QString filename = QFileDialog::getSaveFileName(this, "Record models", "", "Model stream (*.rpsm)");
+    if (filename.isEmpty()) {
+        recordModelsButton->setChecked(false);
+        return;
+    }
+
+    if (!modelRecorder->open(filename, ps->getWidth(), ps->getHeight(), floatDepthCheckBox->isChecked())) {
+        statusBar()->showMessage("ERROR: Could not create " + filename);
+        recordModelsButton->setChecked(false);
+        return;
+    }
+    floatDepthCheckBox->setEnabled(false);
+    recordModelsButton->setText("Stop recording");
+}
+
+void MainWindow::onModelRecordingStopped(int numModels, int numDropped) {
+
+    /* recording also stops by itself if writing fails */
+    if (!modelRecorder->isRecording()) {
+        recordModelsButton->setChecked(false);
+    }
+    setStatusMessage(QString("Recorded %1 models (%2 dropped).").arg(numModels).arg(numDropped));
+}
+
 void MainWindow::onTestModeChecked(int state) {
 
     if (state > 0) {
@@ -197,15 +374,65 @@ void MainWindow::onTestModeChecked(int state) {
 
 void MainWindow::setStatusMessage(QString msg) {
 
-    statusBar()->showMessage(msg);
+    statusBar()->showMessage(msg + " Skipped models: " + QString::number(ps->getMailbox()->getSkipped()));
+}
+
+void MainWindow::onExportProgress(int percent) {
+
+    statusBar()->showMessage(QString("Exporting model: %1%").arg(percent));
+}
+
+void MainWindow::onExportFinished(QString filename, bool success) {
+
+    if (success) {
+        statusBar()->showMessage("Exported model to " + filename);
+    } else {
+        statusBar()->showMessage("ERROR: Could not export model to " + filename);
+    }
+}
+
+void MainWindow::onModelAvailable() {
+
+    /* the view still paints the previous model, the next one is taken once it did */
+    if (!awaitingPaint) {
+        takeLatestModel();
+    }
 }
 
-void MainWindow::onModelFinished(std::vector<cv::Mat> MatXYZN) {
+void MainWindow::onViewPainted() {
+
+    awaitingPaint = false;
+    takeLatestModel();
+}
+
+void MainWindow::takeLatestModel() {
+
+    QString status;
+    if (ps->getMailbox()->take(latestModel, status)) {
+        modelStale = true;
+        normalsStale = true;
+        awaitingPaint = showLatestModel();
+        setStatusMessage(status);
+    }
+}
+
+bool MainWindow::showLatestModel() {
 
     /* we either display object normals or complete reconstruction */
-    modelWidget->renderModel(MatXYZN);
-    cv::Mat Normals = MatXYZN.back();
-    normalsWidget->setNormalsImage(Normals);
+    bool repainting = false;
+    if (modelStale && modelWidget->isVisible()) {
+        modelWidget->renderModel(latestModel);
+        modelStale = false;
+        repainting = true;
+    }
+    if (normalsStale && normalsWidget->isVisible()) {
+        /* rgb normal map of the engine if there is one */
+        cv::Mat Normals = latestModel[5].empty() ? latestModel[3] : latestModel[5];
+        normalsWidget->setNormalsImage(Normals);
+        normalsStale = false;
+        repainting = true;
+    }
+    return repainting;
 }
 
 void MainWindow::onViewRadioButtonsChecked(bool checked) {
@@ -217,4 +444,7 @@ void MainWindow::onViewRadioButtonsChecked(bool checked) {
         normalsWidget->hide();
         modelWidget->show();
     }
+    /* normal map is only rendered while it is displayed */
+    ps->getEngine()->setNormalMap(normalsRadioButton->isChecked());
+    showLatestModel();
 }
@@ -15,6 +15,7 @@
 #include <QtGui/QCheckBox>
 #include <QtGui/QSlider>
 #include <QtGui/QDoubleSpinBox>
+#include <QtGui/QFileDialog>
 #include <QtCore/QTimer>
 #include <QtCore/QString>
 #include <QLabel>
@@ -26,42 +27,68 @@
 #include "modelwidget.h"
 #include "normalswidget.h"
 #include "photometricstereo.h"
+#include "modelrecorder.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
     
 public:
-    MainWindow(QWidget *parent = 0);
+    MainWindow(QWidget *parent = 0, const QString &replayFile = QString(), Camera::PlaybackMode playbackMode = Camera::REALTIME, double playbackRate = 15.0);
     ~MainWindow();
     
 public slots:
     void setStatusMessage(QString msg);
-    void onModelFinished(std::vector<cv::Mat> MatXYZN);
         
 private slots:
+    /** Taking the model just posted unless the views are still painting one */
+    void onModelAvailable();
+    /** Taking the next model, if any, as the views are ready for it */
+    void onViewPainted();
     void onTestModeChecked(int state);
     void onViewRadioButtonsChecked(bool checked);
     void onToggleSettingsMenu();
+    void onRecordToggled(bool checked);
+    void onRecordingStopped(int numFrames, int numDropped);
+    void onRecordModelsToggled(bool checked);
+    void onModelRecordingStopped(int numModels, int numDropped);
+    void onExportProgress(int percent);
+    void onExportFinished(QString filename, bool success);
     
 private:
     void createInterface();
+    /** Displaying and reporting the latest model of the mailbox, if any */
+    void takeLatestModel();
+    /** Rendering the latest model into the visible view, the hidden one catches
+     * up when shown; true if the visible view repaints */
+    bool showLatestModel();
     
     QWidget *centralWidget;
     QGridLayout *gridLayout, *radioButtonsLayout, *paramsLayout;
-    QLabel *maxpqLabel, *lambdaLabel, *muLabel, *minIntensLabel, *unsharpNormsLabel;
+    QHBoxLayout *recordLayout;
+    QLabel *maxpqLabel, *lambdaLabel, *muLabel, *minIntensLabel, *maxIntensLabel, *unsharpNormsLabel, *unsharpRadiusLabel, *temporalSigmaLabel;
     QDoubleSpinBox *maxpqSpinBox, *lambdaSpinBox, *muSpinBox;
-    QSlider *minIntensSlider, *unsharpNormSlider;
+    QSlider *minIntensSlider, *maxIntensSlider, *unsharpNormSlider, *unsharpRadiusSlider, *temporalSigmaSlider;
     QGroupBox *paramsGroupBox;
-    QPushButton *exportButton, *toggleSettingsButton;
+    QPushButton *exportButton, *toggleSettingsButton, *recordButton, *recordModelsButton;
     QRadioButton *normalsRadioButton, *surfaceRadioButton;
-    QCheckBox *testModeCheckBox;
+    QCheckBox *testModeCheckBox, *fastMathCheckBox, *halfStorageCheckBox, *albedoCheckBox, *robustCheckBox, *foregroundCheckBox, *lodCheckBox, *temporalCheckBox, *motionCheckBox, *rawFramesCheckBox, *floatDepthCheckBox;
     QThread *camThread;
     
     Camera *camera;
+    FrameRecorder *recorder;
+    ModelRecorder *modelRecorder;
     CameraWidget *camWidget;
     ModelWidget *modelWidget;
     NormalsWidget *normalsWidget;
     PhotometricStereo *ps;
+    ReconstructionScheduler *scheduler;
+
+    /* models are taken from the ps mailbox as the views paint, instead of
+       queued per reconstruction */
+    std::vector<cv::Mat> latestModel;
+    bool modelStale, normalsStale;
+    /* a model was handed to the visible view and is not painted yet */
+    bool awaitingPaint;
 };
 
 #endif
\ No newline at end of file
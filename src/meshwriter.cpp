@@ -0,0 +1,192 @@
+#include "meshwriter.h"
+
+void MeshWriter::report(const Progress &progress, int row, int numRows, int &lastPercent) {
+
+    int percent = (numRows > 0) ? (100*row) / numRows : 100;
+    if (progress && percent != lastPercent) {
+        lastPercent = percent;
+        progress(percent);
+    }
+}
+
+void MeshWriter::facetNormal(const float *a, const float *b, const float *c, float *n) {
+
+    float u[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+    float v[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+    n[0] = u[1]*v[2] - u[2]*v[1];
+    n[1] = u[2]*v[0] - u[0]*v[2];
+    n[2] = u[0]*v[1] - u[1]*v[0];
+    float len = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    if (len > 0.0f) {
+        n[0] /= len;
+        n[1] /= len;
+        n[2] /= len;
+    }
+}
+
+bool MeshWriter::writePLY(const std::string &filename, const cv::Mat &Z, const cv::Mat &Normals, const Progress &progress) {
+
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!out) {
+        return false;
+    }
+
+    int height = Z.rows, width = Z.cols;
+    long numFaces = 2L * std::max(0, height-1) * std::max(0, width-1);
+    out << "ply\n"
+        << "format binary_little_endian 1.0\n"
+        << "element vertex " << (long)height*width << "\n"
+        << "property float x\nproperty float y\nproperty float z\n"
+        << "property float nx\nproperty float ny\nproperty float nz\n"
+        << "element face " << numFaces << "\n"
+        << "property list uchar int vertex_indices\n"
+        << "end_header\n";
+
+    /* vertices and faces are each written in two passes over the rows, progress
+       covers both; data is written as is, assuming a little endian host */
+    int lastPercent = -1;
+    std::vector<float> vertices(width*6);
+    for (int i=0; i<height; i++) {
+        const float *z = Z.ptr<float>(i);
+        const float *n = Normals.ptr<float>(i);
+        for (int j=0; j<width; j++) {
+            float *v = &vertices[j*6];
+            v[0] = i;
+            v[1] = j;
+            v[2] = z[j];
+            v[3] = n[j*3];
+            v[4] = n[j*3+1];
+            v[5] = n[j*3+2];
+        }
+        out.write((const char*)vertices.data(), vertices.size()*sizeof(float));
+        report(progress, i, 2*height, lastPercent);
+    }
+
+    /* one count byte and three indices per face */
+    const int FACE_SIZE = 1 + 3*sizeof(int32_t);
+    std::vector<char> faces(2*std::max(0, width-1)*FACE_SIZE);
+    for (int i=0; i<height-1; i++) {
+        char *f = faces.data();
+        for (int j=0; j<width-1; j++) {
+            int32_t topLeft = i*width+j;
+            int32_t bottomLeft = topLeft+width;
+            int32_t ids[6] = {topLeft, bottomLeft, topLeft+1, bottomLeft, bottomLeft+1, topLeft+1};
+            for (int t=0; t<2; t++, f+=FACE_SIZE) {
+                f[0] = 3;
+                memcpy(f+1, &ids[t*3], 3*sizeof(int32_t));
+            }
+        }
+        out.write(faces.data(), faces.size());
+        report(progress, height+i, 2*height, lastPercent);
+    }
+
+    report(progress, 1, 1, lastPercent);
+    return out.good();
+}
+
+bool MeshWriter::writeSTL(const std::string &filename, const cv::Mat &Z, const Progress &progress) {
+
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!out) {
+        return false;
+    }
+
+    int height = Z.rows, width = Z.cols;
+    char header[80] = "binary STL of a photometric stereo height field";
+    uint32_t numFacets = 2 * std::max(0, height-1) * std::max(0, width-1);
+    out.write(header, sizeof(header));
+    out.write((const char*)&numFacets, sizeof(numFacets));
+
+    /* facet normal, three vertices and an unused attribute per facet */
+    const int FACET_SIZE = 12*sizeof(float) + sizeof(uint16_t);
+    std::vector<char> facets(2*std::max(0, width-1)*FACET_SIZE, 0);
+    int lastPercent = -1;
+    for (int i=0; i<height-1; i++) {
+        const float *z0 = Z.ptr<float>(i);
+        const float *z1 = Z.ptr<float>(i+1);
+        char *f = facets.data();
+        for (int j=0; j<width-1; j++) {
+            float topLeft[3] = {(float)i, (float)j, z0[j]};
+            float topRight[3] = {(float)i, (float)j+1, z0[j+1]};
+            float bottomLeft[3] = {(float)i+1, (float)j, z1[j]};
+            float bottomRight[3] = {(float)i+1, (float)j+1, z1[j+1]};
+            const float *triangles[2][3] = {{topLeft, bottomLeft, topRight}, {bottomLeft, bottomRight, topRight}};
+            for (int t=0; t<2; t++, f+=FACET_SIZE) {
+                float facet[12];
+                facetNormal(triangles[t][0], triangles[t][1], triangles[t][2], facet);
+                for (int k=0; k<3; k++) {
+                    memcpy(&facet[3+k*3], triangles[t][k], 3*sizeof(float));
+                }
+                memcpy(f, facet, sizeof(facet));
+            }
+        }
+        out.write(facets.data(), facets.size());
+        report(progress, i, height-1, lastPercent);
+    }
+
+    report(progress, 1, 1, lastPercent);
+    return out.good();
+}
+
+bool MeshWriter::writeOBJ(const std::string &filename, const cv::Mat &Z, const cv::Mat &Normals, const Progress &progress) {
+
+    FILE *out = fopen(filename.c_str(), "w");
+    if (out == NULL) {
+        return false;
+    }
+
+    /* text is formatted per row into a reused buffer, obj indices start at 1;
+       the buffer holds two face lines of 20 digit indices, longer text fails */
+    int height = Z.rows, width = Z.cols;
+    int lastPercent = -1;
+    std::vector<char> line(512);
+    std::string rows;
+    bool truncated = false;
+    for (int i=0; i<height; i++) {
+        const float *z = Z.ptr<float>(i);
+        const float *n = Normals.ptr<float>(i);
+        rows.clear();
+        for (int j=0; j<width; j++) {
+            int len = snprintf(&line[0], line.size(), "v %d %d %g\nvn %g %g %g\n", i, j, z[j], n[j*3], n[j*3+1], n[j*3+2]);
+            if (len < 0 || len >= (int)line.size()) {
+                truncated = true;
+                break;
+            }
+            rows.append(&line[0], len);
+        }
+        if (truncated) {
+            break;
+        }
+        fwrite(rows.data(), 1, rows.size(), out);
+        report(progress, i, 2*height, lastPercent);
+    }
+    for (int i=0; i<height-1 && !truncated; i++) {
+        rows.clear();
+        for (int j=0; j<width-1; j++) {
+            long topLeft = (long)i*width+j+1;
+            long bottomLeft = topLeft+width;
+            int len = snprintf(&line[0], line.size(), "f %ld//%ld %ld//%ld %ld//%ld\nf %ld//%ld %ld//%ld %ld//%ld\n",
+                               topLeft, topLeft, bottomLeft, bottomLeft, topLeft+1, topLeft+1,
+                               bottomLeft, bottomLeft, bottomLeft+1, bottomLeft+1, topLeft+1, topLeft+1);
+            if (len < 0 || len >= (int)line.size()) {
+                truncated = true;
+                break;
+            }
+            rows.append(&line[0], len);
+        }
+        if (truncated) {
+            break;
+        }
+        fwrite(rows.data(), 1, rows.size(), out);
+        report(progress, height+i, 2*height, lastPercent);
+    }
+
+    if (truncated) {
+        fclose(out);
+        return false;
+    }
+
+    report(progress, 1, 1, lastPercent);
+    bool written = !ferror(out);
+    return (fclose(out) == 0) && written;
+}
\ No newline at end of file
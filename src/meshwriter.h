@@ -0,0 +1,39 @@
+#ifndef MESHWRITER_H
+#define MESHWRITER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <stdint.h>
+
+#include <opencv2/core/core.hpp>
+
+/** Streaming writers of the triangulated height field, the mesh is generated
+ * row by row straight from the heights and normals without building polydata.
+ * Vertices and triangles are laid out like ModelData: vertex (i,j) is at
+ * (i, j, Z(i,j)), every grid cell split into two triangles. */
+class MeshWriter {
+
+public:
+    /** Called with the percentage written so far */
+    typedef std::function<void(int)> Progress;
+
+    /** Binary little endian PLY with vertex normals */
+    static bool writePLY(const std::string &filename, const cv::Mat &Z, const cv::Mat &Normals, const Progress &progress = Progress());
+    /** Binary STL, facet normals computed from the geometry */
+    static bool writeSTL(const std::string &filename, const cv::Mat &Z, const Progress &progress = Progress());
+    /** Wavefront OBJ with vertex normals */
+    static bool writeOBJ(const std::string &filename, const cv::Mat &Z, const cv::Mat &Normals, const Progress &progress = Progress());
+
+private:
+    /** Reporting progress of rows written, once per percent */
+    static void report(const Progress &progress, int row, int numRows, int &lastPercent);
+    static void facetNormal(const float *a, const float *b, const float *c, float *n);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "modeldata.h"
+
+ModelData::ModelData(int modelWidth, int modelHeight) : stride(1), modelWidth(modelWidth), modelHeight(modelHeight) {
+
+    points = vtkSmartPointer<vtkPoints>::New();
+    polyData = vtkSmartPointer<vtkPolyData>::New();
+
+    /* setup non-changing x,y coords once, as row and column like the engine's */
+    pointArray = vtkSmartPointer<vtkFloatArray>::New();
+    pointArray->SetNumberOfComponents(3);
+    pointArray->SetNumberOfTuples(modelWidth*modelHeight);
+    float *p = pointArray->GetPointer(0);
+    for (int y=0; y<modelHeight; y++) {
+        for (int x=0; x<modelWidth; x++, p+=3) {
+            p[0] = y;
+            p[1] = x;
+            p[2] = 0.0f;
+        }
+    }
+    points->SetData(pointArray);
+
+    /* flat model until the first update */
+    heights = cv::Mat(modelHeight, modelWidth, CV_32F, cv::Scalar::all(0));
+    normals = cv::Mat(modelHeight, modelWidth, CV_32FC3, cv::Scalar(0, 0, 1));
+    normalArray = vtkSmartPointer<vtkFloatArray>::New();
+    normalArray->SetNumberOfComponents(3);
+    normalArray->SetArray(normals.ptr<float>(), modelWidth*modelHeight*3, 1);
+    polyData->GetPointData()->SetNormals(normalArray);
+
+    polyData->SetPoints(points);
+    polyData->SetStrips(getStrips(1));
+}
+
+std::vector<int> ModelData::gridLines(int size, int stride) {
+
+    /* last row or column is always included, the model keeps its extent */
+    std::vector<int> lines;
+    for (int i=0; i<size; i+=stride) {
+        lines.push_back(i);
+    }
+    if (!lines.empty() && lines.back() != size-1) {
+        lines.push_back(size-1);
+    }
+    return lines;
+}
+
+vtkSmartPointer<vtkCellArray> ModelData::getStrips(int stride) {
+
+    std::map<int, vtkSmartPointer<vtkCellArray> >::iterator it = strips.find(stride);
+    if (it != strips.end()) {
+        return it->second;
+    }
+
+    /* one triangle strip per pair of rows, zigzagging between every stride-th
+       grid point of both; connectivity written in a single pass as
+       (number of ids, ids..) per strip */
+    std::vector<int> rows = gridLines(modelHeight, stride);
+    std::vector<int> cols = gridLines(modelWidth, stride);
+    vtkIdType numStrips = std::max(0, (int)rows.size()-1);
+    vtkIdType stripLength = 2*cols.size();
+    vtkSmartPointer<vtkIdTypeArray> ids = vtkSmartPointer<vtkIdTypeArray>::New();
+    ids->SetNumberOfValues(numStrips*(stripLength+1));
+    vtkIdType *id = ids->GetPointer(0);
+    for (vtkIdType r=0; r<numStrips; r++) {
+        vtkIdType top = rows[r]*modelWidth;
+        vtkIdType bottom = rows[r+1]*modelWidth;
+        *id++ = stripLength;
+        for (size_t c=0; c<cols.size(); c++) {
+            *id++ = top + cols[c];
+            *id++ = bottom + cols[c];
+        }
+    }
+
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    cells->SetCells(numStrips, ids);
+    strips[stride] = cells;
+    return cells;
+}
+
+vtkSmartPointer<vtkCellArray> ModelData::getTriangles() {
+
+    if (triangles.GetPointer() != NULL) {
+        return triangles;
+    }
+
+    /* exporters only handle triangles, same winding as the strips */
+    vtkIdType numTriangles = 2*std::max(0, modelHeight-1)*std::max(0, modelWidth-1);
+    vtkSmartPointer<vtkIdTypeArray> ids = vtkSmartPointer<vtkIdTypeArray>::New();
+    ids->SetNumberOfValues(numTriangles*4);
+    vtkIdType *id = ids->GetPointer(0);
+    for (int i=0; i<modelHeight-1; i++) {
+        for (int j=0; j<modelWidth-1; j++) {
+            vtkIdType topLeft = i*modelWidth+j;
+            vtkIdType bottomLeft = topLeft+modelWidth;
+            *id++ = 3; *id++ = topLeft; *id++ = bottomLeft; *id++ = topLeft+1;
+            *id++ = 3; *id++ = bottomLeft; *id++ = bottomLeft+1; *id++ = topLeft+1;
+        }
+    }
+
+    triangles = vtkSmartPointer<vtkCellArray>::New();
+    triangles->SetCells(numTriangles, ids);
+    return triangles;
+}
+
+void ModelData::setStride(int stride) {
+
+    stride = std::max(1, stride);
+    if (stride != this->stride) {
+        this->stride = stride;
+        polyData->SetStrips(getStrips(stride));
+    }
+}
+
+int ModelData::getStride() {
+    return stride;
+}
+
+vtkSmartPointer<vtkPolyData> ModelData::getFullResolution() {
+
+    /* sharing points and normals, only the connectivity differs */
+    vtkSmartPointer<vtkPolyData> full = vtkSmartPointer<vtkPolyData>::New();
+    full->SetPoints(points);
+    full->GetPointData()->SetNormals(normalArray);
+    full->SetPolys(getTriangles());
+    return full;
+}
+
+void ModelData::update(const std::vector<cv::Mat> &MatXYZN) {
+
+    /* results are never modified once handed out, their normals are used in
+       place and only need to stay alive as long as vtk references them */
+    normals = MatXYZN[3].isContinuous() ? MatXYZN[3] : MatXYZN[3].clone();
+    normalArray->SetArray(normals.ptr<float>(), modelWidth*modelHeight*3, 1);
+    albedo = (MatXYZN.size() > 4) ? MatXYZN[4] : cv::Mat();
+
+    /* z-coords written into every third entry, x,y stay untouched; all of them,
+       as the global integration changes the heights of background tiles too */
+    heights = MatXYZN[2];
+    const cv::Mat &Z = heights;
+    float *p = pointArray->GetPointer(0) + 2;
+    for (int y=0; y<modelHeight; y++) {
+        const float *z = Z.ptr<float>(y);
+        for (int x=0; x<modelWidth; x++, p+=3) {
+            *p = z[x];
+        }
+    }
+
+    /* Modified() is expensive and therefore not called automatically
+     if underlying data has changed, only the changed arrays are marked */
+    pointArray->Modified();
+    normalArray->Modified();
+}
+
+vtkSmartPointer<vtkPolyData> ModelData::getPolyData() {
+    return polyData;
+}
+
+cv::Mat ModelData::getHeights() {
+    return heights;
+}
+
+cv::Mat ModelData::getNormals() {
+    return normals;
+}
+
+void ModelData::writePLY(const std::string &filename) {
+
+    vtkSmartPointer<vtkPLYWriter> plyExporter = vtkSmartPointer<vtkPLYWriter>::New();
+    plyExporter->SetInput(getFullResolution());
+    plyExporter->SetFileName(filename.c_str());
+    plyExporter->SetColorModeToDefault();
+    plyExporter->SetArrayName("Colors");
+    plyExporter->Update();
+    plyExporter->Write();
+}
+
+bool ModelData::writeAlbedo(const std::string &filename) {
+
+    if (albedo.empty()) {
+        return false;
+    }
+
+    return ImageWriter::writeAlbedo(filename, albedo, ImageWriter::PNG);
+}
+
+void ModelData::writeSTL(const std::string &filename) {
+
+    vtkSmartPointer<vtkSTLWriter> stlExporter = vtkSmartPointer<vtkSTLWriter>::New();
+    stlExporter->SetInput(getFullResolution());
+    stlExporter->SetFileName(filename.c_str());
+    stlExporter->SetFileTypeToBinary();
+    stlExporter->Update();
+    stlExporter->Write();
+}
\ No newline at end of file
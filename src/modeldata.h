@@ -0,0 +1,73 @@
+#ifndef MODELDATA_H
+#define MODELDATA_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkCellArray.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkSTLWriter.h>
+#include <vtkPLYWriter.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "imagewriter.h"
+
+/** Triangulated grid of a 2.5D model as consumed by vtk, independent of any
+ * widget so it can be filled and exported headless */
+class ModelData {
+
+public:
+    ModelData(int modelWidth, int modelHeight);
+    /** z-coords written in place into the persistent point array, normals are
+     * referenced without copying; x,y-coords never change and are ignored */
+    void update(const std::vector<cv::Mat> &MatXYZN);
+    vtkSmartPointer<vtkPolyData> getPolyData();
+    /** Triangle strips over every stride-th row and column only, points stay
+     * at full resolution; exports always use the full resolution mesh */
+    void setStride(int stride);
+    int getStride();
+    /** Connectivity generated in bulk and cached, strips as rendered by stride
+     * and full resolution triangles as exported */
+    vtkSmartPointer<vtkCellArray> getStrips(int stride);
+    vtkSmartPointer<vtkCellArray> getTriangles();
+    /** Heights and normals of the last update, shared with the results */
+    cv::Mat getHeights();
+    cv::Mat getNormals();
+    void writePLY(const std::string &filename);
+    void writeSTL(const std::string &filename);
+    /** Albedo of the last update as 16-bit image scaled by ImageWriter::ALBEDO_SCALE,
+     * false if there is none */
+    bool writeAlbedo(const std::string &filename);
+
+private:
+    vtkSmartPointer<vtkPolyData> polyData;
+    vtkSmartPointer<vtkPoints> points;
+    /* rendered triangle strips by stride and exported triangles, built on first use */
+    std::map<int, vtkSmartPointer<vtkCellArray> > strips;
+    vtkSmartPointer<vtkCellArray> triangles;
+    int stride;
+    /* interleaved xyz-coords with constant x,y, and normals, owned by vtk */
+    vtkSmartPointer<vtkFloatArray> pointArray, normalArray;
+
+    /* normals of the last update referenced by normalArray, kept alive here */
+    cv::Mat normals;
+    cv::Mat heights;
+    cv::Mat albedo;
+    int modelWidth, modelHeight;
+
+    /** Indices of every stride-th row (or column) and the last one */
+    static std::vector<int> gridLines(int size, int stride);
+    /** Copy of polyData sharing its points, with triangles instead of strips */
+    vtkSmartPointer<vtkPolyData> getFullResolution();
+};
+
+#endif
\ No newline at end of file
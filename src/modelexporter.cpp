@@ -0,0 +1,55 @@
+#include "modelexporter.h"
+
+ModelExporter::ModelExporter(QObject *parent) : QObject(parent) {
+
+}
+
+ModelExporter::~ModelExporter() {
+
+    future.waitForFinished();
+}
+
+bool ModelExporter::start(const QString &filename, Format format, const cv::Mat &Z, const cv::Mat &Normals) {
+
+    if (isRunning()) {
+        return false;
+    }
+    future = QtConcurrent::run(this, &ModelExporter::run, filename, format, Z, Normals);
+    return true;
+}
+
+bool ModelExporter::isRunning() {
+    return future.isRunning();
+}
+
+void ModelExporter::run(QString filename, Format format, cv::Mat Z, cv::Mat Normals) {
+
+    /* signals are emitted on the worker thread, queued to receivers living elsewhere */
+    MeshWriter::Progress progress = std::bind(&ModelExporter::reportProgress, this, std::placeholders::_1);
+    std::string file = filename.toStdString();
+    bool success;
+    ImageWriter::Format imageFormat = ImageWriter::PNG;
+    ImageWriter::formatOf(file, imageFormat);
+    switch (format) {
+        case PLY:
+            success = MeshWriter::writePLY(file, Z, Normals, progress);
+            break;
+        case STL:
+            success = MeshWriter::writeSTL(file, Z, progress);
+            break;
+        case DEPTH_MAP:
+            success = ImageWriter::writeDepth(file, Z, imageFormat);
+            break;
+        case NORMAL_MAP:
+            success = ImageWriter::writeNormals(file, Normals, imageFormat);
+            break;
+        default:
+            success = MeshWriter::writeOBJ(file, Z, Normals, progress);
+            break;
+    }
+    emit finished(filename, success);
+}
+
+void ModelExporter::reportProgress(int percent) {
+    emit progress(percent);
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef MODELEXPORTER_H
+#define MODELEXPORTER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QFuture>
+#include <QtCore/QtConcurrentRun>
+
+#include <opencv2/core/core.hpp>
+
+#include "meshwriter.h"
+#include "imagewriter.h"
+
+/** Exporting models in the background, the heights and normals of a model are
+ * only referenced (results are never modified) and streamed to the file on a
+ * worker thread. Progress and completion are reported via signals. Depth and
+ * normal maps are written in the image format matching the file extension. */
+class ModelExporter : public QObject {
+
+    Q_OBJECT
+
+public:
+    enum Format {PLY, STL, OBJ, DEPTH_MAP, NORMAL_MAP};
+
+    ModelExporter(QObject *parent = 0);
+    /** Waits for a running export */
+    ~ModelExporter();
+    /** Starts exporting given model, false if an export is still running */
+    bool start(const QString &filename, Format format, const cv::Mat &Z, const cv::Mat &Normals);
+    bool isRunning();
+
+signals:
+    void progress(int percent);
+    void finished(QString filename, bool success);
+
+private:
+    QFuture<void> future;
+
+    void run(QString filename, Format format, cv::Mat Z, cv::Mat Normals);
+    void reportProgress(int percent);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "modelmailbox.h"
+
+ModelMailbox::ModelMailbox() : fresh(false), skipped(0) {
+}
+
+bool ModelMailbox::post(const std::vector<cv::Mat> &MatXYZN, const QString &status) {
+
+    QMutexLocker locker(&mutex);
+    bool wasEmpty = !fresh;
+    if (fresh) {
+        skipped++;
+    }
+    /* matrices are shared, never copied */
+    model = MatXYZN;
+    this->status = status;
+    fresh = true;
+    return wasEmpty;
+}
+
+bool ModelMailbox::take(std::vector<cv::Mat> &MatXYZN, QString &status) {
+
+    QMutexLocker locker(&mutex);
+    if (!fresh) {
+        return false;
+    }
+    MatXYZN = model;
+    status = this->status;
+    fresh = false;
+    return true;
+}
+
+int ModelMailbox::getSkipped() {
+
+    QMutexLocker locker(&mutex);
+    return skipped;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef MODELMAILBOX_H
+#define MODELMAILBOX_H
+
+#include <vector>
+
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QString>
+
+#include <opencv2/core/core.hpp>
+
+/** Hand over of finished models from the reconstruction threads to the gui
+ * thread, holding only the latest model: a model posted before the previous
+ * one was taken replaces it and is counted as skipped */
+class ModelMailbox {
+
+public:
+    ModelMailbox();
+    /** Posting a model with its status message, true if the mailbox was empty,
+     * i.e. the receiver has to be woken up to take it */
+    bool post(const std::vector<cv::Mat> &MatXYZN, const QString &status);
+    /** Latest model and its status, false if none arrived since the last call */
+    bool take(std::vector<cv::Mat> &MatXYZN, QString &status);
+    /** Number of models replaced before they were taken */
+    int getSkipped();
+
+private:
+    QMutex mutex;
+    std::vector<cv::Mat> model;
+    QString status;
+    bool fresh;
+    int skipped;
+};
+
+#endif
\ No newline at end of file
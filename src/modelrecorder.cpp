@@ -0,0 +1,132 @@
+#include "modelrecorder.h"
+
+ModelRecorder::ModelRecorder(QObject *parent) : QThread(parent), recording(false), floatDepth(false), numDropped(0) {
+
+    /* leaving the cores to the reconstruction */
+    pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() / 4));
+}
+
+ModelRecorder::~ModelRecorder() {
+
+    close();
+}
+
+bool ModelRecorder::open(const QString &filename, int width, int height, bool floatDepth) {
+
+    close();
+
+    /* the writer is only used by the recorder thread once it is started */
+    if (!writer.open(filename, width, height)) {
+        return false;
+    }
+
+    mutex.lock();
+    this->floatDepth = floatDepth;
+    numDropped = 0;
+    clock.start();
+    recording = true;
+    mutex.unlock();
+
+    start(QThread::LowPriority);
+    return true;
+}
+
+void ModelRecorder::close() {
+
+    mutex.lock();
+    recording = false;
+    changed.wakeAll();
+    mutex.unlock();
+
+    wait();
+}
+
+bool ModelRecorder::isRecording() {
+
+    QMutexLocker locker(&mutex);
+    return recording;
+}
+
+int ModelRecorder::droppedModels() {
+
+    QMutexLocker locker(&mutex);
+    return numDropped;
+}
+
+void ModelRecorder::append(std::vector<cv::Mat> MatXYZN) {
+
+    QMutexLocker locker(&mutex);
+    if (!recording) {
+        return;
+    }
+
+    /* never stall the reconstruction, dropping models if compression can not keep up */
+    if (queue.size() >= MAX_QUEUED) {
+        numDropped++;
+        return;
+    }
+
+    Entry *e = new Entry;
+    e->Z = MatXYZN[2];
+    e->Normals = MatXYZN[3];
+    e->timestamp = clock.nsecsElapsed() / 1000;
+    e->encoded = false;
+    queue.append(e);
+    pool.start(new Encoder(this, e));
+}
+
+ModelRecorder::Encoder::Encoder(ModelRecorder *recorder, Entry *entry) : recorder(recorder), entry(entry) {
+
+}
+
+void ModelRecorder::Encoder::run() {
+
+    QByteArray chunk = ModelStream::encode(entry->Z, entry->Normals, entry->timestamp, recorder->floatDepth);
+    recorder->encoded(entry, chunk);
+}
+
+void ModelRecorder::encoded(Entry *entry, const QByteArray &chunk) {
+
+    QMutexLocker locker(&mutex);
+    entry->chunk = chunk;
+    entry->encoded = true;
+    /* models are released as soon as they are compressed */
+    entry->Z = cv::Mat();
+    entry->Normals = cv::Mat();
+    changed.wakeAll();
+}
+
+void ModelRecorder::run() {
+
+    bool failed = false;
+
+    mutex.lock();
+    for (;;) {
+        /* writing in order of arrival, waiting for the oldest model to be compressed */
+        while (!queue.isEmpty() && queue.first()->encoded) {
+            Entry *e = queue.takeFirst();
+            mutex.unlock();
+
+            /* models still being compressed are awaited, but not written after a failure */
+            if (!failed && !writer.append(e->chunk)) {
+                std::cerr << "ERROR: Could not write model, recording stopped" << std::endl;
+                failed = true;
+            }
+            delete e;
+
+            mutex.lock();
+            if (failed) {
+                recording = false;
+            }
+        }
+        if (!recording && queue.isEmpty()) {
+            break;
+        }
+        changed.wait(&mutex);
+    }
+    mutex.unlock();
+
+    int numModels = writer.modelCount();
+    writer.close();
+    emit recordingStopped(numModels, droppedModels());
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef MODELRECORDER_H
+#define MODELRECORDER_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QRunnable>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include "modelstream.h"
+
+/** Recording every finished model into a compressed model stream. Models are
+ * only queued by the reconstruction threads, compressing them happens on a
+ * small pool of its own and writing them, in order, on the recorder thread. */
+class ModelRecorder : public QThread {
+
+    Q_OBJECT
+
+public:
+    ModelRecorder(QObject *parent = 0);
+    ~ModelRecorder();
+    /** Start recording models of given size into given file, heights either
+     * quantized to 16 bit or as float; false if the file can not be created */
+    bool open(const QString &filename, int width, int height, bool floatDepth);
+    /** Stop recording, writing all queued models */
+    void close();
+    bool isRecording();
+    int droppedModels();
+
+public slots:
+    /** Queue model for recording, its data must not be modified afterwards */
+    void append(std::vector<cv::Mat> MatXYZN);
+
+signals:
+    void recordingStopped(int numModels, int numDropped);
+
+protected:
+    void run();
+
+private:
+    struct Entry {
+        cv::Mat Z, Normals;
+        int64_t timestamp;
+        QByteArray chunk;
+        bool encoded;
+    };
+
+    class Encoder : public QRunnable {
+    public:
+        Encoder(ModelRecorder *recorder, Entry *entry);
+        void run();
+    private:
+        ModelRecorder *recorder;
+        Entry *entry;
+    };
+    friend class Encoder;
+
+    ModelStreamWriter writer;
+    QThreadPool pool;
+    QMutex mutex;
+    QWaitCondition changed;
+    QList<Entry*> queue;
+    QElapsedTimer clock;
+    bool recording, floatDepth;
+    int numDropped;
+
+    /* upper limit of models being compressed or waiting to be written */
+    static const int MAX_QUEUED = 32;
+    void encoded(Entry *entry, const QByteArray &chunk);
+};
+
+#endif
\ No newline at end of file
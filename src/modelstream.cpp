@@ -0,0 +1,330 @@
+#include "modelstream.h"
+
+const char ModelStream::MAGIC[4] = { 'R', 'P', 'S', 'M' };
+
+void ModelStream::octEncode(const float *n, int16_t *oct) {
+
+    /* projecting onto the octahedron, the lower half is folded over the upper one */
+    float l1 = fabs(n[0]) + fabs(n[1]) + fabs(n[2]);
+    float x = (l1 > 0.0f) ? n[0]/l1 : 0.0f;
+    float y = (l1 > 0.0f) ? n[1]/l1 : 0.0f;
+    if (n[2] < 0.0f) {
+        float fx = (1.0f - fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    oct[0] = (int16_t)cvRound(std::max(-1.0f, std::min(1.0f, x)) * 32767.0f);
+    oct[1] = (int16_t)cvRound(std::max(-1.0f, std::min(1.0f, y)) * 32767.0f);
+}
+
+void ModelStream::octDecode(const int16_t *oct, float *n) {
+
+    float x = oct[0] / 32767.0f;
+    float y = oct[1] / 32767.0f;
+    float z = 1.0f - fabs(x) - fabs(y);
+    if (z < 0.0f) {
+        float fx = (1.0f - fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    float len = std::sqrt(x*x + y*y + z*z);
+    n[0] = x/len;
+    n[1] = y/len;
+    n[2] = z/len;
+}
+
+QByteArray ModelStream::encode(const cv::Mat &Z, const cv::Mat &Normals, int64_t timestamp, bool floatDepth, int level) {
+
+    int width = Z.cols, height = Z.rows;
+
+    ModelChunkHeader h;
+    memset(&h, 0, sizeof(h));
+    h.flags = floatDepth ? MODEL_FLAG_FLOAT_DEPTH : 0;
+    h.timestamp = timestamp;
+    double zMin = 0, zMax = 0;
+    cv::minMaxLoc(Z, &zMin, &zMax);
+    h.zMin = zMin;
+    h.zMax = zMax;
+
+    /* smooth surfaces leave small row-wise deltas, which compress well; deltas
+       wrap around in 16-bit and are exactly reversible */
+    size_t zSize = (size_t)width*height * (floatDepth ? sizeof(float) : sizeof(uint16_t));
+    QByteArray payload(zSize + (size_t)width*height*2*sizeof(int16_t), 0);
+    float zScale = (h.zMax > h.zMin) ? 65535.0f / (h.zMax - h.zMin) : 0.0f;
+    if (floatDepth) {
+        for (int i=0; i<height; i++) {
+            memcpy(payload.data() + (size_t)i*width*sizeof(float), Z.ptr<float>(i), width*sizeof(float));
+        }
+    } else {
+        uint16_t *dz = (uint16_t*)payload.data();
+        for (int i=0; i<height; i++, dz+=width) {
+            const float *z = Z.ptr<float>(i);
+            uint16_t prev = 0;
+            for (int j=0; j<width; j++) {
+                uint16_t q = (uint16_t)cvRound((z[j] - h.zMin) * zScale);
+                dz[j] = q - prev;
+                prev = q;
+            }
+        }
+    }
+
+    int16_t *dn = (int16_t*)(payload.data() + zSize);
+    for (int i=0; i<height; i++, dn+=2*width) {
+        const float *n = Normals.ptr<float>(i);
+        int16_t prev[2] = {0, 0};
+        for (int j=0; j<width; j++) {
+            int16_t oct[2];
+            octEncode(n + j*3, oct);
+            dn[j*2] = (int16_t)(uint16_t)(oct[0] - prev[0]);
+            dn[j*2+1] = (int16_t)(uint16_t)(oct[1] - prev[1]);
+            prev[0] = oct[0];
+            prev[1] = oct[1];
+        }
+    }
+
+    QByteArray compressed = qCompress(payload, level);
+    h.payloadSize = compressed.size();
+
+    QByteArray chunk((const char*)&h, sizeof(h));
+    chunk.append(compressed);
+    return chunk;
+}
+
+bool ModelStream::decode(const QByteArray &chunk, int width, int height, cv::Mat &Z, cv::Mat &Normals) {
+
+    if (chunk.size() < (int)sizeof(ModelChunkHeader)) {
+        return false;
+    }
+    ModelChunkHeader h;
+    memcpy(&h, chunk.constData(), sizeof(h));
+
+    bool floatDepth = (h.flags & MODEL_FLAG_FLOAT_DEPTH) != 0;
+    size_t zSize = (size_t)width*height * (floatDepth ? sizeof(float) : sizeof(uint16_t));
+    QByteArray payload = qUncompress(chunk.mid(sizeof(h), h.payloadSize));
+    if ((size_t)payload.size() != zSize + (size_t)width*height*2*sizeof(int16_t)) {
+        return false;
+    }
+
+    Z.create(height, width, CV_32F);
+    if (floatDepth) {
+        memcpy(Z.data, payload.constData(), zSize);
+    } else {
+        float zStep = (h.zMax - h.zMin) / 65535.0f;
+        const uint16_t *dz = (const uint16_t*)payload.constData();
+        for (int i=0; i<height; i++, dz+=width) {
+            float *z = Z.ptr<float>(i);
+            uint16_t q = 0;
+            for (int j=0; j<width; j++) {
+                q += dz[j];
+                z[j] = h.zMin + q * zStep;
+            }
+        }
+    }
+
+    Normals.create(height, width, CV_32FC3);
+    const int16_t *dn = (const int16_t*)(payload.constData() + zSize);
+    for (int i=0; i<height; i++, dn+=2*width) {
+        float *n = Normals.ptr<float>(i);
+        int16_t oct[2] = {0, 0};
+        for (int j=0; j<width; j++) {
+            oct[0] = (int16_t)(uint16_t)(oct[0] + dn[j*2]);
+            oct[1] = (int16_t)(uint16_t)(oct[1] + dn[j*2+1]);
+            octDecode(oct, n + j*3);
+        }
+    }
+
+    return true;
+}
+
+ModelStreamReader::ModelStreamReader() {
+
+    memset(&header, 0, sizeof(header));
+}
+
+ModelStreamReader::~ModelStreamReader() {
+
+    close();
+}
+
+bool ModelStreamReader::open(const QString &filename) {
+
+    close();
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "ERROR: Could not open model stream " << filename.toStdString() << std::endl;
+        return false;
+    }
+
+    if (file.read((char*)&header, sizeof(header)) != sizeof(header) || memcmp(header.magic, ModelStream::MAGIC, 4) != 0) {
+        std::cerr << "ERROR: " << filename.toStdString() << " is not a model stream" << std::endl;
+        close();
+        return false;
+    }
+
+    if (header.version != ModelStream::VERSION) {
+        std::cerr << "ERROR: Unsupported model stream format in " << filename.toStdString() << std::endl;
+        close();
+        return false;
+    }
+
+    /* recorder might have been killed before writing the index */
+    bool indexed = false;
+    if (header.indexOffset != 0 && file.seek(header.indexOffset)) {
+        index.resize(header.modelCount);
+        qint64 indexSize = (qint64)index.size()*sizeof(ModelIndexEntry);
+        indexed = index.empty() || file.read((char*)&index[0], indexSize) == indexSize;
+    }
+    if (!indexed && !scan()) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool ModelStreamReader::scan() {
+
+    index.clear();
+    qint64 offset = sizeof(ModelStreamHeader);
+    qint64 end = (header.indexOffset != 0) ? (qint64)header.indexOffset : file.size();
+    while (offset + (qint64)sizeof(ModelChunkHeader) <= end) {
+        ModelChunkHeader h;
+        if (!file.seek(offset) || file.read((char*)&h, sizeof(h)) != sizeof(h)) {
+            break;
+        }
+        /* truncated last chunk is ignored */
+        qint64 next = offset + sizeof(h) + h.payloadSize;
+        if (next > end) {
+            break;
+        }
+        ModelIndexEntry e;
+        e.offset = offset;
+        e.timestamp = h.timestamp;
+        index.push_back(e);
+        offset = next;
+    }
+    header.modelCount = index.size();
+    return true;
+}
+
+void ModelStreamReader::close() {
+
+    if (file.isOpen()) {
+        file.close();
+    }
+    memset(&header, 0, sizeof(header));
+    index.clear();
+}
+
+bool ModelStreamReader::isOpen() const {
+
+    return file.isOpen();
+}
+
+int ModelStreamReader::width() const {
+
+    return header.width;
+}
+
+int ModelStreamReader::height() const {
+
+    return header.height;
+}
+
+int ModelStreamReader::modelCount() const {
+
+    return index.size();
+}
+
+int64_t ModelStreamReader::timestamp(int idx) const {
+
+    return index[idx].timestamp;
+}
+
+bool ModelStreamReader::read(int idx, cv::Mat &Z, cv::Mat &Normals) {
+
+    ModelChunkHeader h;
+    if (idx < 0 || idx >= (int)index.size() || !file.seek(index[idx].offset) || file.read((char*)&h, sizeof(h)) != sizeof(h)) {
+        return false;
+    }
+    QByteArray chunk((const char*)&h, sizeof(h));
+    chunk.append(file.read(h.payloadSize));
+    return ModelStream::decode(chunk, header.width, header.height, Z, Normals);
+}
+
+ModelStreamWriter::ModelStreamWriter() {
+
+    memset(&header, 0, sizeof(header));
+}
+
+ModelStreamWriter::~ModelStreamWriter() {
+
+    close();
+}
+
+bool ModelStreamWriter::open(const QString &filename, int width, int height) {
+
+    close();
+    file.setFileName(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        std::cerr << "ERROR: Could not create model stream " << filename.toStdString() << std::endl;
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ModelStream::MAGIC, 4);
+    header.version = ModelStream::VERSION;
+    header.width = width;
+    header.height = height;
+    if (file.write((const char*)&header, sizeof(header)) != sizeof(header)) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void ModelStreamWriter::close() {
+
+    if (file.isOpen()) {
+        /* index follows the last chunk, header is rewritten to point to it */
+        header.modelCount = index.size();
+        header.indexOffset = file.pos();
+        if (!index.empty()) {
+            file.write((const char*)&index[0], index.size()*sizeof(ModelIndexEntry));
+        }
+        file.seek(0);
+        file.write((const char*)&header, sizeof(header));
+        file.close();
+    }
+    index.clear();
+}
+
+bool ModelStreamWriter::isOpen() const {
+
+    return file.isOpen();
+}
+
+bool ModelStreamWriter::append(const QByteArray &chunk) {
+
+    if (!file.isOpen() || chunk.size() < (int)sizeof(ModelChunkHeader)) {
+        return false;
+    }
+
+    ModelIndexEntry e;
+    e.offset = file.pos();
+    e.timestamp = ((const ModelChunkHeader*)chunk.constData())->timestamp;
+    if (file.write(chunk) != chunk.size()) {
+        return false;
+    }
+    index.push_back(e);
+
+    return true;
+}
+
+int ModelStreamWriter::modelCount() const {
+
+    return index.size();
+}
\ No newline at end of file
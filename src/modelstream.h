@@ -0,0 +1,113 @@
+#ifndef MODELSTREAM_H
+#define MODELSTREAM_H
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <QtCore/QByteArray>
+
+/* chunk flag marking heights stored as float instead of 16-bit */
+#define MODEL_FLAG_FLOAT_DEPTH 0x1
+
+/** File header of a recorded model stream. A stream is a single file with this
+ * header followed by one variable-size chunk (chunk header + compressed
+ * payload) per model, and an index of all chunks written on close. */
+struct ModelStreamHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height;
+    /** number of models in the index, 0 if the stream was not closed */
+    uint32_t modelCount;
+    uint32_t reserved;
+    /** file offset of the index, 0 if the stream was not closed */
+    uint64_t indexOffset;
+};
+
+/** Header in front of the compressed payload of each chunk. The payload holds
+ * the heights (16-bit quantized between zMin and zMax, or float) followed by
+ * the normals in 2 x 16-bit octahedral encoding, each as row-wise deltas. */
+struct ModelChunkHeader {
+    uint32_t flags;
+    /** size of the compressed payload following this header */
+    uint32_t payloadSize;
+    /** reconstruction time in microseconds since the start of the stream */
+    int64_t timestamp;
+    float zMin, zMax;
+};
+
+/** Index entry of a chunk */
+struct ModelIndexEntry {
+    uint64_t offset;
+    int64_t timestamp;
+};
+
+class ModelStream {
+
+public:
+    static const char MAGIC[4];
+    static const uint32_t VERSION = 1;
+    /** Chunk (header and compressed payload) of a single model */
+    static QByteArray encode(const cv::Mat &Z, const cv::Mat &Normals, int64_t timestamp, bool floatDepth, int level = 1);
+    /** Model of a chunk, false if it is corrupt */
+    static bool decode(const QByteArray &chunk, int width, int height, cv::Mat &Z, cv::Mat &Normals);
+
+private:
+    /** Unit normal to two snorm16 values and back */
+    static void octEncode(const float *n, int16_t *oct);
+    static void octDecode(const int16_t *oct, float *n);
+};
+
+/** Random access to a recorded model stream, streams which were not closed
+ * are indexed by scanning their chunks */
+class ModelStreamReader {
+
+public:
+    ModelStreamReader();
+    ~ModelStreamReader();
+    bool open(const QString &filename);
+    void close();
+    bool isOpen() const;
+    int width() const;
+    int height() const;
+    int modelCount() const;
+    int64_t timestamp(int idx) const;
+    /** Decompressed heights and normals of the model at given index */
+    bool read(int idx, cv::Mat &Z, cv::Mat &Normals);
+
+private:
+    QFile file;
+    ModelStreamHeader header;
+    std::vector<ModelIndexEntry> index;
+
+    bool scan();
+};
+
+/** Append-only writer of model streams */
+class ModelStreamWriter {
+
+public:
+    ModelStreamWriter();
+    ~ModelStreamWriter();
+    bool open(const QString &filename, int width, int height);
+    /** Writing the index, only then the stream is complete */
+    void close();
+    bool isOpen() const;
+    /** Appends an encoded chunk */
+    bool append(const QByteArray &chunk);
+    int modelCount() const;
+
+private:
+    QFile file;
+    ModelStreamHeader header;
+    std::vector<ModelIndexEntry> index;
+};
+
+#endif
\ No newline at end of file
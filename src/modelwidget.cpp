@@ -1,44 +1,13 @@
 #include "modelwidget.h"
 
-ModelWidget::ModelWidget(QWidget *parent, int modelWidth, int modelHeight) : QVTKWidget(parent), modelWidth(modelWidth), modelHeight(modelHeight) {
+ModelWidget::ModelWidget(QWidget *parent, int modelWidth, int modelHeight) : QVTKWidget(parent), levelOfDetail(true), inspecting(false), liveStride(1) {
 
     /* creating visualization pipeline which basically looks like this:
      vtkPoints -> vtkPolyData -> vtkPolyDataMapper -> vtkActor -> vtkRenderer */
-    points = vtkSmartPointer<vtkPoints>::New();
-    polyData = vtkSmartPointer<vtkPolyData>::New();
+    modelData = new ModelData(modelWidth, modelHeight);
     modelMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
     modelActor = vtkSmartPointer<vtkActor>::New();
     renderer = vtkSmartPointer<vtkRenderer>::New();
-    vtkTriangles = vtkSmartPointer<vtkCellArray>::New();
-
-    /* setup non-changing x,y coords */
-    for (int y=0; y<modelHeight; y++) {
-        for (int x=0; x<modelWidth; x++) {
-            points->InsertNextPoint(x, y, 1.0);
-        }
-    }
-    
-    /* reused memory holding normals and 3d data */
-    cnp = new float[modelWidth*modelHeight*3];
-    cmp = new float[modelWidth*modelHeight*3];
-
-    /* setup the connectivity between grid points */
-    vtkSmartPointer<vtkTriangle> triangle = vtkSmartPointer<vtkTriangle>::New();
-    triangle->GetPointIds()->SetNumberOfIds(3);
-    for (int i=0; i<modelHeight-1; i++) {
-        for (int j=0; j<modelWidth-1; j++) {
-            triangle->GetPointIds()->SetId(0, j+(i*modelWidth));
-            triangle->GetPointIds()->SetId(1, (i+1)*modelWidth+j);
-            triangle->GetPointIds()->SetId(2, j+(i*modelWidth)+1);
-            vtkTriangles->InsertNextCell(triangle);
-            triangle->GetPointIds()->SetId(0, (i+1)*modelWidth+j);
-            triangle->GetPointIds()->SetId(1, (i+1)*modelWidth+j+1);
-            triangle->GetPointIds()->SetId(2, j+(i*modelWidth)+1);
-            vtkTriangles->InsertNextCell(triangle);
-        }
-    }
-    polyData->SetPoints(points);
-    polyData->SetPolys(vtkTriangles);
     
     /* create two scene lights illuminating both sides of 2.5D model */
     light1 = vtkSmartPointer<vtkLight>::New();
@@ -51,7 +20,7 @@ ModelWidget::ModelWidget(QWidget *parent, int modelWidth, int modelHeight) : QVT
     light2->SetLightTypeToSceneLight();
     renderer->AddLight(light2);
 
-    modelMapper->SetInput(polyData);
+    modelMapper->SetInput(modelData->getPolyData());
     /* immediate render mode faster/better for large datasets */
     modelMapper->ImmediateModeRenderingOn();
     renderer->SetBackground(.45, .45, .9);
@@ -68,81 +37,122 @@ ModelWidget::ModelWidget(QWidget *parent, int modelWidth, int modelHeight) : QVT
     modelActor->GetProperty()->SetInterpolationToPhong();
     
     renderer->AddActor(modelActor);
+
+    exporter = new ModelExporter(this);
+
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(IDLE_MILLIS);
+    connect(idleTimer, SIGNAL(timeout()), this, SLOT(showFullResolution()));
 }
 
 ModelWidget::~ModelWidget() {
 
-    delete [] cnp;
-    delete [] cmp;
+    delete modelData;
 }
 
 void ModelWidget::renderModel(std::vector<cv::Mat> MatXYZN) {
     
-    /* splitting normals from x,y,z coords */
-    cv::Mat Normals = MatXYZN.back();
-    MatXYZN.pop_back();
-    float *np = &Normals.at<float>(0);
-    /* memcpy(void* destination, void* source, size_t num) */
-    memcpy(cnp, np, modelWidth*modelHeight*3*sizeof(float));
-    vtkFloatArray *nArray = vtkFloatArray::New();
-    nArray->SetNumberOfComponents(3);
-    nArray->SetArray(cnp, modelWidth*modelHeight*3, 1);
-    
-    polyData->GetPointData()->SetNormals(nArray);
-
-    /* pointing to first entry of a 3-channel matrix
-     with x,y,z coords according to channel */
-    cv::Mat Model;
-    cv::merge(MatXYZN, Model);
-    float *mp = &Model.at<float>(0);
-    memcpy(cmp, mp, modelWidth*modelHeight*3*sizeof(float));
-    vtkFloatArray *fArray = vtkFloatArray::New();
-    fArray->SetNumberOfComponents(3);
-    fArray->SetArray(cmp, modelWidth*modelHeight*3, 1);
+    TRACE_SCOPE("ModelWidget::renderModel");
+    modelData->update(MatXYZN);
 
-    points->Reset();
-    points->SetData(fArray);
-
-    /* Modified() is expensive and therefore not called automatically
-     if underlying data has changed */
-    points->Modified();
+    /* live models are decimated unless the user inspects them */
+    if (levelOfDetail && !inspecting) {
+        modelData->setStride(liveStride);
+        idleTimer->start();
+    }
 
     /* refreshing the widget to display the new data */
     update();
+}
+
+ModelExporter *ModelWidget::getExporter() {
+    return exporter;
+}
 
-    /* cleaning up */
-    nArray->Delete();
-    fArray->Delete();
+void ModelWidget::paintEvent(QPaintEvent *event) {
+
+    TRACE_SCOPE("ModelWidget::paint");
+    QElapsedTimer clock;
+    clock.start();
+    QVTKWidget::paintEvent(event);
+
+    /* halving the stride quadruples the triangles, going finer needs some headroom */
+    if (idleTimer->isActive() && modelData->getStride() == liveStride) {
+        qint64 millis = clock.elapsed();
+        if (millis > RENDER_BUDGET_MILLIS && liveStride < MAX_STRIDE) {
+            liveStride *= 2;
+        } else if (millis * 6 < RENDER_BUDGET_MILLIS && liveStride > 1) {
+            liveStride /= 2;
+        }
+    }
+    emit painted();
+}
+
+void ModelWidget::setLevelOfDetail(bool enabled) {
+
+    levelOfDetail = enabled;
+    if (!enabled) {
+        showFullResolution();
+    }
+}
+
+void ModelWidget::showFullResolution() {
+
+    idleTimer->stop();
+    if (modelData->getStride() != 1) {
+        modelData->setStride(1);
+        update();
+    }
+}
+
+void ModelWidget::mousePressEvent(QMouseEvent *event) {
+
+    inspecting = true;
+    showFullResolution();
+    QVTKWidget::mousePressEvent(event);
+}
+
+void ModelWidget::mouseReleaseEvent(QMouseEvent *event) {
+
+    inspecting = false;
+    QVTKWidget::mouseReleaseEvent(event);
 }
 
 void ModelWidget::exportModel() {
 
-    QString filename = QFileDialog::getSaveFileName(this, "Export model", "", "Polygon File Format (*.ply);;Wavefront OBJ (*.obj);;Stereolithography (*.stl)");
+    QString depthFilter = "Depth map (*.png *.tif *.exr)";
+    QString normalFilter = "Normal map (*.png *.tif *.exr)";
+    QString albedoFilter = "Albedo map (*.png)";
+    QString selectedFilter;
+    QString filename = QFileDialog::getSaveFileName(this, "Export model", "", "Polygon File Format (*.ply);;Wavefront OBJ (*.obj);;Stereolithography (*.stl);;" + depthFilter + ";;" + normalFilter + ";;" + albedoFilter, &selectedFilter);
     
     QFileInfo fi(filename);
     QString ext = fi.suffix();
     
-    if (ext.compare("ply") == 0) {
-        vtkSmartPointer<vtkPLYWriter> plyExporter = vtkSmartPointer<vtkPLYWriter>::New();
-        plyExporter->SetInput(polyData);
-        plyExporter->SetFileName(filename.toStdString().c_str());
-        plyExporter->SetColorModeToDefault();
-        plyExporter->SetArrayName("Colors");
-        plyExporter->Update();
-        plyExporter->Write();
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    /* meshes and maps are written from the current model in the background */
+    bool started = true;
+    if (selectedFilter == depthFilter) {
+        started = exporter->start(filename, ModelExporter::DEPTH_MAP, modelData->getHeights(), modelData->getNormals());
+    } else if (selectedFilter == normalFilter) {
+        started = exporter->start(filename, ModelExporter::NORMAL_MAP, modelData->getHeights(), modelData->getNormals());
+    } else if (ext.compare("ply") == 0) {
+        started = exporter->start(filename, ModelExporter::PLY, modelData->getHeights(), modelData->getNormals());
+    } else if (ext.compare("png") == 0) {
+        if (!modelData->writeAlbedo(filename.toStdString())) {
+            std::cerr << "No albedo computed, enable it in the settings menu." << std::endl;
+        }
     } else if (ext.compare("obj") == 0) {
-        vtkSmartPointer<vtkOBJExporter> objExporter = vtkSmartPointer<vtkOBJExporter>::New();
-        objExporter->SetInput(renderWindow);
-        objExporter->SetFilePrefix(filename.toStdString().c_str());
-        objExporter->Update();
-        objExporter->Write();
+        started = exporter->start(filename, ModelExporter::OBJ, modelData->getHeights(), modelData->getNormals());
     } else {
-        vtkSmartPointer<vtkSTLWriter> stlExporter = vtkSmartPointer<vtkSTLWriter>::New();
-        stlExporter->SetInput(polyData);
-        stlExporter->SetFileName(filename.toStdString().c_str());
-        stlExporter->SetFileTypeToBinary();
-        stlExporter->Update();
-        stlExporter->Write();
+        started = exporter->start(filename, ModelExporter::STL, modelData->getHeights(), modelData->getNormals());
+    }
+    if (!started) {
+        std::cerr << "Previous export still running, try again later." << std::endl;
     }
 
 }
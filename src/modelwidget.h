@@ -1,6 +1,8 @@
 #ifndef MODELWIDGET_H
 #define MODELWIDGET_H
 
+#include <iostream>
+
 #include <vtkSmartPointer.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkPolyData.h>
@@ -12,14 +14,6 @@
 #include <vtkLight.h>
 #include <vtkLightCollection.h>
 #include <vtkRenderer.h>
-#include <vtkCellArray.h>
-#include <vtkPoints.h>
-#include <vtkPointData.h>
-#include <vtkFloatArray.h>
-#include <vtkTriangle.h>
-#include <vtkOBJExporter.h>
-#include <vtkSTLWriter.h>
-#include <vtkPLYWriter.h>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -28,6 +22,13 @@
 #include <QVTKWidget.h>
 #include <QtGui/QFileDialog>
 #include <QtCore/QFileInfo>
+#include <QtCore/QTimer>
+#include <QtCore/QElapsedTimer>
+#include <QtGui/QMouseEvent>
+
+#include "modeldata.h"
+#include "modelexporter.h"
+#include "trace.h"
 
 class ModelWidget : public QVTKWidget {
     
@@ -38,9 +39,27 @@ public:
     ~ModelWidget();
     /** renders given opencv matrix with xyz-coords and normals structured as a tensor */
     void renderModel(std::vector<cv::Mat> MatXYZN);
+    /** Background exporter of the meshes, reporting its progress */
+    ModelExporter *getExporter();
     
 public slots:
     void exportModel();
+    /** Decimating live models to stay within the render budget, full resolution
+     * is shown once the stream pauses or while the user inspects the model */
+    void setLevelOfDetail(bool enabled);
+    
+signals:
+    /** Model was rendered, the next one can be set */
+    void painted();
+
+protected:
+    /** vtk renders the scene when painting, render time drives the live stride */
+    void paintEvent(QPaintEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+    
+private slots:
+    void showFullResolution();
     
 private:
     vtkSmartPointer<vtkPolyDataMapper> modelMapper;
@@ -48,12 +67,18 @@ private:
     vtkSmartPointer<vtkLight> light1, light2;
     vtkSmartPointer<vtkRenderer> renderer;
     vtkSmartPointer<vtkRenderWindow> renderWindow;
-    vtkSmartPointer<vtkPolyData> polyData;
-    vtkSmartPointer<vtkCellArray> vtkTriangles;
-    vtkSmartPointer<vtkPoints> points;
-    
-    int modelWidth, modelHeight;
-    float *cnp, *cmp;
+    ModelData *modelData;
+    ModelExporter *exporter;
+
+    /* level of detail of live models */
+    bool levelOfDetail;
+    bool inspecting;
+    int liveStride;
+    /* models arriving within this interval count as live stream */
+    QTimer *idleTimer;
+    static const int IDLE_MILLIS = 500;
+    static const int MAX_STRIDE = 8;
+    static const int RENDER_BUDGET_MILLIS = 15;
 };
 
 #endif
\ No newline at end of file
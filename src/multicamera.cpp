@@ -0,0 +1,88 @@
+#include "multicamera.h"
+
+MultiCamera::MultiCamera(QObject *parent) : QObject(parent) {
+
+    scheduler = new ReconstructionScheduler(this);
+    connect(scheduler, SIGNAL(report(QString)), this, SLOT(onReport(QString)));
+}
+
+MultiCamera::~MultiCamera() {
+
+    stop();
+    delete scheduler;
+    for (size_t i=0; i<psProcesses.size(); i++) {
+        delete psProcesses[i];
+    }
+}
+
+int MultiCamera::open(int numStations) {
+
+    /* first camera tells us how many devices are connected */
+    Camera *first = new Camera();
+    int numDevices = first->numDevices();
+    if (numStations < 0) {
+        numStations = numDevices;
+    }
+
+    for (int i=0; i<numStations; i++) {
+        Camera *camera = (i == 0) ? first : new Camera();
+        if (i < numDevices && camera->open(i)) {
+            camera->reset();
+        } else {
+            std::cerr << "Station " << i << ": no camera, running in test mode" << std::endl;
+            camera->setTestMode(true);
+        }
+
+        PhotometricStereo *ps = new PhotometricStereo(camera->width, camera->height, camera->avgImageIntensity());
+        ps->setScheduler(scheduler);
+        scheduler->addStation(ps, QString("Station %1").arg(i));
+
+        /* capture thread per camera, images are handed over to ps process directly */
+        QThread *camThread = new QThread;
+        camera->moveToThread(camThread);
+        connect(camThread, SIGNAL(started()), camera, SLOT(start()));
+        connect(camera, SIGNAL(stopped()), camThread, SLOT(quit()));
+        connect(camera, SIGNAL(newCroppedFrame(cv::Mat)), ps, SLOT(setImage(cv::Mat)), Qt::DirectConnection);
+        connect(camera, SIGNAL(sequenceRestarted()), ps, SLOT(restartSequence()), Qt::DirectConnection);
+
+        cameras.push_back(camera);
+        camThreads.push_back(camThread);
+        psProcesses.push_back(ps);
+    }
+    if (numStations == 0) {
+        delete first;
+    }
+
+    return numStations;
+}
+
+void MultiCamera::start() {
+
+    for (size_t i=0; i<camThreads.size(); i++) {
+        camThreads[i]->start();
+        camThreads[i]->setPriority(QThread::TimeCriticalPriority);
+    }
+    scheduler->setReportInterval(1000);
+}
+
+void MultiCamera::stop() {
+
+    scheduler->setReportInterval(0);
+    for (size_t i=0; i<cameras.size(); i++) {
+        /* cameras are stopped on their capture thread, never while capturing a frame */
+        if (camThreads[i]->isRunning()) {
+            QMetaObject::invokeMethod(cameras[i], "stop", Qt::BlockingQueuedConnection);
+        }
+        camThreads[i]->quit();
+        camThreads[i]->wait();
+        delete camThreads[i];
+        delete cameras[i];
+    }
+    cameras.clear();
+    camThreads.clear();
+}
+
+void MultiCamera::onReport(QString stats) {
+
+    std::cout << stats.toStdString() << std::endl;
+}
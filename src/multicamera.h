@@ -0,0 +1,42 @@
+#ifndef MULTICAMERA_H
+#define MULTICAMERA_H
+
+#include <iostream>
+#include <vector>
+
+#include <QtCore/QObject>
+#include <QtCore/QThread>
+#include <QtCore/QString>
+
+#include "camera.h"
+#include "photometricstereo.h"
+#include "scheduler.h"
+
+/** Headless operation of several stations on one host. Every camera captures
+ * in its own thread, all reconstructions share one worker pool. */
+class MultiCamera : public QObject {
+
+    Q_OBJECT
+
+public:
+    MultiCamera(QObject *parent = 0);
+    ~MultiCamera();
+    /** Setup given number of stations, -1 using all connected cameras. Stations
+     * exceeding the connected cameras run in test mode. */
+    int open(int numStations = -1);
+    void start();
+
+public slots:
+    void stop();
+
+private slots:
+    void onReport(QString stats);
+
+private:
+    std::vector<Camera*> cameras;
+    std::vector<QThread*> camThreads;
+    std::vector<PhotometricStereo*> psProcesses;
+    ReconstructionScheduler *scheduler;
+};
+
+#endif
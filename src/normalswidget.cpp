@@ -71,12 +71,23 @@ void NormalsWidget::setupRenderLayer(int width, int height) {
 
 void NormalsWidget::setNormalsImage(cv::Mat img) {
 
-    /* OpenCV creates BGR images, vtk expects RGB */
-    // cv::cvtColor(img, img, CV_BGR2RGB);
-    /* scale pixel values between 0 - 255 */
-    img.convertTo(img, CV_8U, 255);
+    TRACE_SCOPE("NormalsWidget::setNormalsImage");
 
-    importer->SetImportVoidPointer(img.data);
+    /* normal maps rendered by the engine are used as they are, without copying */
+    if (img.type() == CV_8UC3 && img.isContinuous()) {
+        image = img;
+    } else {
+        img.convertTo(image, CV_8UC3, 127.5, 127.5);
+    }
+
+    importer->SetImportVoidPointer(image.data);
     importer->Modified();
     update();
 }
+
+void NormalsWidget::paintEvent(QPaintEvent *event) {
+
+    TRACE_SCOPE("NormalsWidget::paint");
+    QVTKWidget::paintEvent(event);
+    emit painted();
+}
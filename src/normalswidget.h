@@ -26,12 +26,26 @@
 
 #include <QVTKWidget.h>
 
+#include "trace.h"
+
 class NormalsWidget : public QVTKWidget {
+
+    Q_OBJECT
         
 public:
     NormalsWidget(QWidget *parent = 0, int width=0, int height=0);
     ~NormalsWidget();
+    /** Displays an 8-bit rgb normal map as is, float normals are encoded as
+     * (n+1)/2 first; the image is referenced until the next one is set */
     void setNormalsImage(cv::Mat img);
+
+signals:
+    /** Image was rendered, the next one can be set */
+    void painted();
+
+protected:
+    /** vtk renders the scene when painting */
+    void paintEvent(QPaintEvent *event);
     
 private:
     /** vtk render window */
@@ -44,6 +58,8 @@ private:
     vtkSmartPointer<vtkImageData> imgData;
     /** vtk image importer for converting a CvMat to vtk image data */
     vtkSmartPointer<vtkImageImport> importer;
+    /** displayed image, the importer points into it */
+    cv::Mat image;
     /** preparing rendering layer for displaying image */
     void setupRenderLayer(int width, int height);
 };
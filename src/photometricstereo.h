@@ -4,7 +4,6 @@
 #include <iostream>
 #include <stdio.h>
 #include <vector>
-#include <sys/time.h>
 
 #include <QtCore/QObject>
 #include <QtCore/QString>
@@ -13,12 +12,14 @@
 #include <QMutex>
 
 #include <opencv2/core/core.hpp>
-#include <opencv2/highgui/highgui.hpp>
-#include <opencv2/imgproc/imgproc.hpp>
-#include "OpenCL/cl.hpp"
-#include "oclutils.h"
+#include "reconstructionengine.h"
+#include "scheduler.h"
+#include "modelmailbox.h"
+#include "trace.h"
 #include "config.h"
 
+/** Qt adapter of the reconstruction engine, collecting the images of a set
+ * from the camera and publishing finished models via signals and a mailbox */
 class PhotometricStereo : public QObject {
 
     Q_OBJECT
@@ -32,61 +33,64 @@ public:
     float getMu();
     float getMinIntensity();
     float getUnsharpScale();
+    int getUnsharpRadius();
+    bool getFastMath();
+    bool getHalfStorage();
+    bool getAlbedo();
+    bool getRobust();
+    bool getForegroundOnly();
+    bool getTemporalFilter();
+    bool getMotionCompensation();
+    float getTemporalSigma();
+    int getMaxIntensity();
+    int getWidth();
+    int getHeight();
+    ReconstructionEngine *getEngine();
+    /** Latest finished model, for consumers polling at their own rate */
+    ModelMailbox *getMailbox();
+    /** Reconstructions are run on given scheduler instead of on a private thread */
+    void setScheduler(ReconstructionScheduler *scheduler);
     
 public slots:
     void setImage(cv::Mat image);
+    /** Images following do not continue the previous ones, e.g. a replay
+     * looped or the source changed; the temporal filter restarts with the
+     * next complete set */
+    void restartSequence();
     void setMaxPQ(double val);
     void setLambda(double val);
     void setMu(double val);
     void setMinIntensity(int val);
     void setUnsharpScale(int val);
+    void setUnsharpRadius(int val);
+    void setFastMath(bool toggle);
+    void setHalfStorage(bool toggle);
+    void setAlbedo(bool toggle);
+    void setRobust(bool toggle);
+    void setForegroundOnly(bool toggle);
+    void setTemporalFilter(bool toggle);
+    void setMotionCompensation(bool toggle);
+    void setTemporalSigma(int val);
+    void setMaxIntensity(int val);
     
 signals:
-    void executionTime(QString timeMillis);
+    /** Mailbox received a model while empty, later ones replace it until taken */
+    void modelAvailable();
     void modelFinished(std::vector<cv::Mat> MatXYZN);
     
 private:
-    /* device variables */
-    std::vector<cl::Device> devices;
-    cl::Program program;
-    cl::Context context;
-    cl::CommandQueue queue;
-    cl::Kernel calcNormKernel, integKernel, updateNormKernel;
-    
-    /* opencl buffer */
-    cl::Image2D cl_img1, cl_img2, cl_img3, cl_img4, cl_img5, cl_img6, cl_img7, cl_img8;
-    cl::Buffer cl_Pgrads, cl_Qgrads;
-    cl::Buffer cl_Sinv, cl_N;
-    cl::Buffer cl_P, cl_Q, cl_Z;
-    
-    /* debugging variables */
-    cl_int error;
-    cl::Event event;
+    ReconstructionEngine *engine;
+    ModelMailbox mailbox;
+
     QFuture<void> future;
     QMutex mutex;
     
-    /* ps parameters adjustable by user input */
-    float maxpq;
-    float lambda, mu;
-    int minIntensity;
-    float unsharpScaleFactor;
-    
-    /* ps images */
-    std::vector<cv::Mat> psImages;
+    /* ps images, the last complete set is handed over to execute() */
+    std::vector<cv::Mat> psImages, completeSet;
+    /* restarts of the set being collected and of the complete set, kept until a set is executed */
+    bool restartPending, completeRestart;
     int imgIdx;
-    
-    /* model size */
-    int width, height;
-    
-    /* non-changing x,y coordinates of 3d model */
-    cv::Mat XCoords, YCoords;
-    
-    /* light directions */
-    cv::Mat lightSrcsInv;
-    
-    cv::Mat getGlobalHeights(cv::Mat Pgrads, cv::Mat Qgrads);
-    long getMilliSecs();
-    cv::Mat readCalibratedLights();
+    ReconstructionScheduler *scheduler;
 };
 
 
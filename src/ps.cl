@@ -1,125 +1,411 @@
 
+/* work-group size of tiled kernels, passed by the host with -DTILE_SIZE which
+   rounds its ranges up accordingly */
+#ifndef TILE_SIZE
+#error "TILE_SIZE has to be defined by the build options"
+#endif
+
+/* storage of normals and depth gradients, compiled with -DHALF_STORAGE these
+   are stored as fp16 while all arithmetic stays in fp32 */
+#ifdef HALF_STORAGE
+typedef half store_t;
+#define loadScalar(idx, p) vload_half(idx, p)
+#define storeScalar(v, idx, p) vstore_half(v, idx, p)
+#define loadNormal(idx, p) vload_half4(idx, p)
+#define storeNormal(v, idx, p) vstore_half4(v, idx, p)
+#define storeNormal3(v, idx, p) vstore_half3(v, idx, p)
+#else
+typedef float store_t;
+#define loadScalar(idx, p) ((p)[idx])
+#define storeScalar(v, idx, p) ((p)[idx] = (v))
+#define loadNormal(idx, p) vload4(idx, p)
+#define storeNormal(v, idx, p) vstore4(v, idx, p)
+#define storeNormal3(v, idx, p) vstore3(v, idx, p)
+#endif
+
+/* display encoding of normals as (n+1)/2 in 8-bit rgb, tightly packed */
+inline void storeRgb(float3 n, int idx, __global uchar *rgb) {
+    vstore3(convert_uchar3_sat_rte((n + 1.0f) * 127.5f), idx, rgb);
+}
+
 __constant sampler_t sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP | CLK_FILTER_NEAREST;
 
-inline uchar8 getIntensityVector(int i, int j, image2d_t img1, image2d_t img2, image2d_t img3, image2d_t img4, image2d_t img5, image2d_t img6, image2d_t img7, image2d_t img8) {
+/* images are read at their (x,y) shifts against the first one, compensating
+   motion during the set; shifted pixels outside an image read as zero */
+inline uchar8 getIntensityVector(int i, int j, image2d_t img1, image2d_t img2, image2d_t img3, image2d_t img4, image2d_t img5, image2d_t img6, image2d_t img7, image2d_t img8, __constant int2 *shifts) {
     
+    int2 c = (int2)(j,i);
     uchar8 I;
-    I.s0 = read_imageui(img1, sampler, (int2)(j,i)).x;
-    I.s1 = read_imageui(img2, sampler, (int2)(j,i)).x;
-    I.s2 = read_imageui(img3, sampler, (int2)(j,i)).x;
-    I.s3 = read_imageui(img4, sampler, (int2)(j,i)).x;
-    I.s4 = read_imageui(img5, sampler, (int2)(j,i)).x;
-    I.s5 = read_imageui(img6, sampler, (int2)(j,i)).x;
-    I.s6 = read_imageui(img7, sampler, (int2)(j,i)).x;
-    I.s7 = read_imageui(img8, sampler, (int2)(j,i)).x;
+    I.s0 = read_imageui(img1, sampler, c + shifts[0]).x;
+    I.s1 = read_imageui(img2, sampler, c + shifts[1]).x;
+    I.s2 = read_imageui(img3, sampler, c + shifts[2]).x;
+    I.s3 = read_imageui(img4, sampler, c + shifts[3]).x;
+    I.s4 = read_imageui(img5, sampler, c + shifts[4]).x;
+    I.s5 = read_imageui(img6, sampler, c + shifts[5]).x;
+    I.s6 = read_imageui(img7, sampler, c + shifts[6]).x;
+    I.s7 = read_imageui(img8, sampler, c + shifts[7]).x;
     return I;
 }
 
-inline float4 getNormalVector(__global float *Sinv, uchar8 I) {
+/* index of the pseudo-inverse without the lights a < b, following the
+   full set (0) and the eight sets without a single light (1..8) */
+inline int pairSubset(int a, int b) {
+    return 9 + a*(15-a)/2 + (b-a-1);
+}
+
+inline float4 getNormalVector(__constant float8 *Sinv, uchar8 I, float *albedo) {
     
+    /* rows of the light pseudo-inverse times intensities, as two 4-wide dot products each */
+    float8 i = convert_float8(I);
     float4 n = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
-    n.x =   (Sinv[8*0+0]*I.s0)+
-            (Sinv[8*0+1]*I.s1)+
-            (Sinv[8*0+2]*I.s2)+
-            (Sinv[8*0+3]*I.s3)+
-            (Sinv[8*0+4]*I.s4)+
-            (Sinv[8*0+5]*I.s5)+
-            (Sinv[8*0+6]*I.s6)+
-            (Sinv[8*0+7]*I.s7);
-    
-    n.y =   (Sinv[8*1+0]*I.s0)+
-            (Sinv[8*1+1]*I.s1)+
-            (Sinv[8*1+2]*I.s2)+
-            (Sinv[8*1+3]*I.s3)+
-            (Sinv[8*1+4]*I.s4)+
-            (Sinv[8*1+5]*I.s5)+
-            (Sinv[8*1+6]*I.s6)+
-            (Sinv[8*1+7]*I.s7);
-    
-    n.z =   (Sinv[8*2+0]*I.s0)+
-            (Sinv[8*2+1]*I.s1)+
-            (Sinv[8*2+2]*I.s2)+
-            (Sinv[8*2+3]*I.s3)+
-            (Sinv[8*2+4]*I.s4)+
-            (Sinv[8*2+5]*I.s5)+
-            (Sinv[8*2+6]*I.s6)+
-            (Sinv[8*2+7]*I.s7);
+    n.x = dot(Sinv[0].lo, i.lo) + dot(Sinv[0].hi, i.hi);
+    n.y = dot(Sinv[1].lo, i.lo) + dot(Sinv[1].hi, i.hi);
+    n.z = dot(Sinv[2].lo, i.lo) + dot(Sinv[2].hi, i.hi);
     
     /* surface albedo */
     float p = length(n);
+    *albedo = p;
     if (p > 0.0f) { n /= p; }
     if (n.z <= 0.0f) { n.z = 1.0f; }
     return normalize(n);
 }
 
-__kernel void calcNormals(__read_only image2d_t img1, __read_only image2d_t img2, __read_only image2d_t img3, __read_only image2d_t img4, __read_only image2d_t img5, __read_only image2d_t img6, __read_only image2d_t img7, __read_only image2d_t img8, int width, int height, __global float *Sinv, __global float *P, __global float *Q, __global float *N, float maxpq, int mini) {
+/* first pixel of the work-group's tile; sparse ranges hold one tile per entry
+   of the list of active tiles along dimension 0 */
+inline int2 tileOrigin(__global const int *tiles, int sparse, int width) {
+    if (sparse) {
+        int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        int t = tiles[get_group_id(0)];
+        return (int2)((t / tilesX) * TILE_SIZE, (t % tilesX) * TILE_SIZE);
+    }
+    return (int2)(get_group_id(0) * TILE_SIZE, get_group_id(1) * TILE_SIZE);
+}
+
+/* one work-group per tile, a tile is active if it or its one pixel halo holds
+   foreground, as the 3x3 unsharp masking reaches one pixel into the background;
+   foreground are pixels calcNormals would not reject, i.e. with at least minLit
+   of the lights at or above mini; active tiles are appended to the list */
+__kernel __attribute__((reqd_work_group_size(TILE_SIZE, TILE_SIZE, 1)))
+void maskTiles(__read_only image2d_t img1, __read_only image2d_t img2, __read_only image2d_t img3, __read_only image2d_t img4, __read_only image2d_t img5, __read_only image2d_t img6, __read_only image2d_t img7, __read_only image2d_t img8, int width, int height, int mini, int minLit, __global int *tiles, volatile __global int *numTiles, __constant int2 *shifts) {
+
+    __local int active;
+
+    int li = get_local_id(0);
+    int lj = get_local_id(1);
+    int i0 = get_group_id(0)*TILE_SIZE - 1;
+    int j0 = get_group_id(1)*TILE_SIZE - 1;
+
+    if (li == 0 && lj == 0) { active = 0; }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* pixels outside the image read as zero, i.e. as background */
+    for (int t = li*TILE_SIZE+lj; t < (TILE_SIZE+2)*(TILE_SIZE+2); t += TILE_SIZE*TILE_SIZE) {
+        uchar8 I = getIntensityVector(i0 + t/(TILE_SIZE+2), j0 + t%(TILE_SIZE+2), img1, img2, img3, img4, img5, img6, img7, img8, shifts);
+        uchar v[8];
+        vstore8(I, 0, v);
+        int lit = 0;
+        for (int k = 0; k < 8; k++) {
+            lit += (v[k] >= mini) ? 1 : 0;
+        }
+        if (lit >= minLit) { atomic_or(&active, 1); }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (li == 0 && lj == 0 && active) {
+        tiles[atomic_inc(numTiles)] = get_group_id(0)*get_num_groups(1) + get_group_id(1);
+    }
+}
+
+/* tiles of the list set to what calcNormals and updateNormals write for
+   background, dense ranges reset the whole image */
+__kernel __attribute__((reqd_work_group_size(TILE_SIZE, TILE_SIZE, 1)))
+void resetTiles(__global const int *tiles, int sparse, int width, int height, __global store_t *P, __global store_t *Q, __global store_t *N, __global store_t *Nout, __global float *A, __global uchar *rgb) {
+
+    int2 o = tileOrigin(tiles, sparse, width);
+    int i = o.x + get_local_id(0);
+    int j = o.y + get_local_id(1);
+    if (i >= height || j >= width) { return; }
+
+    storeScalar(0.0f, (i*width)+j, P);
+    storeScalar(0.0f, (i*width)+j, Q);
+    storeNormal((float4)(0.0f, 0.0f, 1.0f, 0.0f), (i*width)+j, N);
+    storeNormal3((float3)(0.0f, 0.0f, 1.0f), (i*width)+j, Nout);
+    storeRgb((float3)(0.0f, 0.0f, 1.0f), (i*width)+j, rgb);
+    A[(i*width)+j] = 0.0f;
+}
+
+__kernel void calcNormals(__read_only image2d_t img1, __read_only image2d_t img2, __read_only image2d_t img3, __read_only image2d_t img4, __read_only image2d_t img5, __read_only image2d_t img6, __read_only image2d_t img7, __read_only image2d_t img8, int width, int height, __constant float8 *Sinv, __global store_t *P, __global store_t *Q, __global store_t *N, float maxpq, int mini, __global float *A, int writeAlbedo, int robust, int maxi, __global const int *tiles, int sparse, __constant int2 *shifts) {
     
-    /* get current i,j position in image */
-    int i = get_global_id(0);
-    int j = get_global_id(1);
+    /* get current i,j position in image, sparse ranges run over active tiles only */
+    int i, j;
+    if (sparse) {
+        int2 o = tileOrigin(tiles, sparse, width);
+        i = o.x + get_local_id(0);
+        j = o.y + get_local_id(1);
+        if (i >= height || j >= width) { return; }
+    } else {
+        i = get_global_id(0);
+        j = get_global_id(1);
+    }
     
-    /* calculate surface normal */
-    uchar8 I = getIntensityVector(i, j, img1, img2, img3, img4, img5, img6, img7, img8);
-    float4 n = getNormalVector(Sinv, I);
+    uchar8 I = getIntensityVector(i, j, img1, img2, img3, img4, img5, img6, img7, img8, shifts);
+    
+    /* pseudo-inverses of all light subsets are stacked as 3 rows each, the full set first */
+    int subset = 0;
+    bool valid;
+    if (robust) {
+        /* finding darkest, second darkest and brightest light */
+        uchar v[8];
+        vstore8(I, 0, v);
+        int dark = 0, bright = 0;
+        for (int k = 1; k < 8; k++) {
+            if (v[k] < v[dark]) { dark = k; }
+            if (v[k] > v[bright]) { bright = k; }
+        }
+        int second = (dark == 0) ? 1 : 0;
+        for (int k = 0; k < 8; k++) {
+            if (k != dark && v[k] < v[second]) { second = k; }
+        }
+        
+        /* a single shadowed light and a specular highlight are dropped, more shadows reject the pixel */
+        bool dropDark = v[dark] < mini;
+        bool dropBright = v[bright] >= maxi && bright != dark;
+        valid = v[second] >= mini;
+        if (dropDark && dropBright) {
+            subset = pairSubset(min(dark, bright), max(dark, bright));
+        } else if (dropDark) {
+            subset = 1 + dark;
+        } else if (dropBright) {
+            subset = 1 + bright;
+        }
+    } else {
+        valid = I.s0 >= mini && I.s1 >= mini && I.s2 >= mini && I.s3 >= mini && I.s4 >= mini && I.s5 >= mini && I.s6 >= mini && I.s7 >= mini;
+    }
     
-    /* clamp intensitiy */
+    /* calculate surface normal */
+    float albedo;
+    float4 n = getNormalVector(Sinv + 3*subset, I, &albedo);
     
-    /* updated depth gradients as in [Wei2001] */
+    /* updated depth gradients as in [Wei2001], gradients exceeding maxpq are rejected */
+    /* rejected pixels are background, exactly as written by resetTiles */
     float p = n.x/n.z;
     float q = n.y/n.z;
-    if (fabs(p) < maxpq && fabs(q) < maxpq) {
-        if( I.s0 >= mini && I.s1 >= mini && I.s2 >= mini && I.s3 >= mini && I.s4 >= mini && I.s5 >= mini && I.s6 >= mini && I.s7 >= mini) {
-            P[(i*width*1)+(j*1)+(0)] = p;
-            Q[(i*width*1)+(j*1)+(0)] = q;
-        } else {
-            P[(i*width*1)+(j*1)+(0)] = 0.0f;
-            Q[(i*width*1)+(j*1)+(0)] = 0.0f;
-            n.x = 0.0f;
-            n.y = 0.0f;
-            n.z = 1.0f;
-        }
-        
+    if (!valid) {
+        storeScalar(0.0f, (i*width)+j, P);
+        storeScalar(0.0f, (i*width)+j, Q);
+        n.x = 0.0f;
+        n.y = 0.0f;
+        n.z = 1.0f;
+        albedo = 0.0f;
+    } else if (fabs(p) < maxpq && fabs(q) < maxpq) {
+        storeScalar(p, (i*width)+j, P);
+        storeScalar(q, (i*width)+j, Q);
+    } else {
+        storeScalar(0.0f, (i*width)+j, P);
+        storeScalar(0.0f, (i*width)+j, Q);
     }
     
-    /* offset: (row * numCols * numChannels) + (col * numChannels) + (channel) */
-    N[(i*width*3)+(j*3)+(0)] = n.x;
-    N[(i*width*3)+(j*3)+(1)] = n.y;
-    N[(i*width*3)+(j*3)+(2)] = n.z;
+    /* normals are kept 4-wide on the device */
+    n.w = 0.0f;
+    storeNormal(n, (i*width)+j, N);
+
+    /* albedo comes for free, it is only written if requested */
+    if (writeAlbedo) {
+        A[(i*width)+j] = albedo;
+    }
 }
 
-__kernel void updateNormals(__global float *N, int width, int height, __global float *P, __global float *Q, float scale) {
+/* temporal filtering of consecutive reconstructions, a scalar kalman filter per
+   pixel shared by its gradients and normal; filtered values and their variance
+   stay on the device. Normals deviating from the filtered ones by more than
+   MOTION_GATE times the expected variance are taken as motion */
+#define MOTION_GATE 16.0f
+
+/* counting moving pixels of the set, counters alternate between sets */
+__kernel __attribute__((reqd_work_group_size(TILE_SIZE, TILE_SIZE, 1)))
+void detectMotion(__global const store_t *N, __global const float4 *Ns, __global const float *V, int width, int height, float r, float q, __global int *moved, int frame, __global const int *tiles, int sparse) {
+
+    __local int count;
+
+    int2 o = tileOrigin(tiles, sparse, width);
+    int li = get_local_id(0);
+    int lj = get_local_id(1);
+    int i  = o.x + li;
+    int j  = o.y + lj;
+
+    if (li == 0 && lj == 0) { count = 0; }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (i < height && j < width) {
+        int idx = (i*width)+j;
+        float4 d = loadNormal(idx, N) - Ns[idx];
+        if (dot(d, d) > MOTION_GATE * (V[idx] + q + r)) {
+            atomic_inc(&count);
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (li == 0 && lj == 0 && count > 0) {
+        atomic_add(&moved[frame & 1], count);
+    }
+}
+
+/* blending the set into the filtered state, which is restarted from the set
+   wherever it moved and everywhere once more than maxMoved pixels did */
+__kernel __attribute__((reqd_work_group_size(TILE_SIZE, TILE_SIZE, 1)))
+void filterTemporal(__global store_t *P, __global store_t *Q, __global store_t *N, __global float *Ps, __global float *Qs, __global float4 *Ns, __global float *V, int width, int height, float r, float q, int maxMoved, __global int *moved, int frame, int reset, __global const int *tiles, int sparse) {
+
+    int2 o = tileOrigin(tiles, sparse, width);
+    int i  = o.x + get_local_id(0);
+    int j  = o.y + get_local_id(1);
+
+    /* counter of the next set is cleared here, ahead of its detectMotion */
+    if (get_global_id(0) == 0 && get_global_id(1) == 0) {
+        moved[(frame + 1) & 1] = 0;
+    }
+    if (i >= height || j >= width) { return; }
+
+    int idx = (i*width)+j;
+    float p = loadScalar(idx, P);
+    float pq = loadScalar(idx, Q);
+    float4 n = loadNormal(idx, N);
+
+    /* predicted variance, the filtered values are expected to stay */
+    float v = V[idx] + q;
+    float4 d = n - Ns[idx];
+    if (reset || moved[frame & 1] > maxMoved || dot(d, d) > MOTION_GATE * (v + r)) {
+        Ps[idx] = p;
+        Qs[idx] = pq;
+        Ns[idx] = n;
+        V[idx] = r;
+        return;
+    }
+
+    /* gain is high while the filter is uncertain, low once it converged */
+    float k = v / (v + r);
+    p = Ps[idx] + k * (p - Ps[idx]);
+    pq = Qs[idx] + k * (pq - Qs[idx]);
+    n = normalize(Ns[idx] + k * d);
+
+    Ps[idx] = p;
+    Qs[idx] = pq;
+    Ns[idx] = n;
+    V[idx] = (1.0f - k) * v;
+    storeScalar(p, idx, P);
+    storeScalar(pq, idx, Q);
+    storeNormal(n, idx, N);
+}
+
+__kernel __attribute__((reqd_work_group_size(TILE_SIZE, TILE_SIZE, 1)))
+void updateNormals(__global const store_t *N, __global store_t *Nout, int width, int height, float scale, __global const int *tiles, int sparse, __global uchar *rgb, int writeRgb) {
+
+    /* tile of normals with one pixel halo, shared by the work-group */
+    __local float4 tile[TILE_SIZE+2][TILE_SIZE+2];
+
+    /* get current i,j position in image, range is rounded up to full tiles or
+       runs over the active tiles only */
+    int2 o = tileOrigin(tiles, sparse, width);
+    int li = get_local_id(0);
+    int lj = get_local_id(1);
+    int i  = o.x + li;
+    int j  = o.y + lj;
+    int i0 = o.x - 1;
+    int j0 = o.y - 1;
+
+    /* staging tile and halo cooperatively, coordinates clamped to the image */
+    for (int t = li*TILE_SIZE+lj; t < (TILE_SIZE+2)*(TILE_SIZE+2); t += TILE_SIZE*TILE_SIZE) {
+        int y = clamp(i0 + t/(TILE_SIZE+2), 0, height-1);
+        int x = clamp(j0 + t%(TILE_SIZE+2), 0, width-1);
+        tile[t/(TILE_SIZE+2)][t%(TILE_SIZE+2)] = loadNormal((y*width)+x, N);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (i >= height || j >= width) { return; }
+
+    float4 n = tile[li+1][lj+1];
+
+    /* edges are passed through */
+    if (i > 0 && j > 0 && i < height-1 && j < width-1) {
+        /* get average of normal vectors over a 3x3 local patch */
+        float4 nsum = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
+        for (int y = 0; y < 3; y++) {
+            for (int x = 0; x < 3; x++) {
+                nsum += tile[li+y][lj+x];
+            }
+        }
+
+        /* unsharp masking normals [Malzbender2006] */
+        n = n + scale * (n - normalize(nsum));
+        if (n.z < 0.0f) {n.z = 0.0f; }
+        n = normalize(n);
+    }
+
+    /* tightly packed 3 channel output as read by the host, and displayed if requested */
+    storeNormal3(n.xyz, (i*width)+j, Nout);
+    if (writeRgb) {
+        storeRgb(n.xyz, (i*width)+j, rgb);
+    }
+}
+
+/* separable box filter as running sums, cost per pixel is independent of the
+   radius; windows are clipped at the image borders, their sum is normalized later */
+__kernel void boxRows(__global const store_t *N, __global float4 *S, int width, int height, int radius) {
+
+    /* one work-item per row */
+    int i = get_global_id(0);
+    if (i >= height) { return; }
+
+    int row = i*width;
+    float4 sum = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
+    for (int x = 0; x <= min(radius, width-1); x++) {
+        sum += loadNormal(row+x, N);
+    }
+    S[(i*width)] = sum;
+    for (int j = 1; j < width; j++) {
+        if (j+radius < width) { sum += loadNormal(row+j+radius, N); }
+        if (j-radius-1 >= 0) { sum -= loadNormal(row+j-radius-1, N); }
+        S[(i*width)+j] = sum;
+    }
+}
+
+__kernel void boxColumns(__global const float4 *S, __global float4 *B, int width, int height, int radius) {
+
+    /* one work-item per column, neighbouring work-items access neighbouring memory */
+    int j = get_global_id(0);
+    if (j >= width) { return; }
+
+    float4 sum = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
+    for (int y = 0; y <= min(radius, height-1); y++) {
+        sum += S[(y*width)+j];
+    }
+    B[j] = sum;
+    for (int i = 1; i < height; i++) {
+        if (i+radius < height) { sum += S[((i+radius)*width)+j]; }
+        if (i-radius-1 >= 0) { sum -= S[((i-radius-1)*width)+j]; }
+        B[(i*width)+j] = sum;
+    }
+}
+
+__kernel void unsharpNormals(__global const store_t *N, __global const float4 *B, __global store_t *Nout, int width, int height, float scale, __global uchar *rgb, int writeRgb) {
 
     /* get current i,j position in image */
     int i  = get_global_id(0);
     int j  = get_global_id(1);
-    
-    /* avoid edges */
-    if (i < 1 || j < 1) { return; }
-    if (i == height-1 || j == width-1 ) { return; }
-    
-    /* get average of normal vectors over a 9x9 local patch */
-    float4 nsum = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
-    for(int y = i-1; y <= i+1; y++) {
-        for(int x = j-1; x <= j+1; x++) {
-            nsum.x += N[(y*width*3)+(x*3)+(0)];
-            nsum.y += N[(y*width*3)+(x*3)+(1)];
-            nsum.z += N[(y*width*3)+(x*3)+(2)];
-        }
+
+    float4 n = loadNormal((i*width)+j, N);
+
+    /* edges are passed through */
+    if (i > 0 && j > 0 && i < height-1 && j < width-1) {
+        /* unsharp masking normals [Malzbender2006] */
+        n = n + scale * (n - normalize(B[(i*width)+j]));
+        if (n.z < 0.0f) {n.z = 0.0f; }
+        n = normalize(n);
+    }
+
+    storeNormal3(n.xyz, (i*width)+j, Nout);
+    if (writeRgb) {
+        storeRgb(n.xyz, (i*width)+j, rgb);
     }
-    
-    /* unsharp masking normals [Malzbender2006] */
-    float4 n;
-    n.x = N[(i*width*3)+(j*3)+(0)];
-    n.y = N[(i*width*3)+(j*3)+(1)];
-    n.z = N[(i*width*3)+(j*3)+(2)];
-    n = n + scale * (n - normalize(nsum));
-    if (n.z < 0.0f) {n.z = 0.0f; }
-    normalize(n);
-    
-    /* offset: (row * numCols * numChannels) + (col * numChannels) + (channel) */
-    N[(i*width*3)+(j*3)+(0)] = n.x;
-    N[(i*width*3)+(j*3)+(1)] = n.y;
-    N[(i*width*3)+(j*3)+(2)] = n.z;
 }
 
 __kernel void integrate(__global float *P, __global float *Q, __global float *Z, int width, int height, float lambda, float mu) {
@@ -0,0 +1,1100 @@
+#include "reconstructionengine.h"
+
+std::vector<cv::Mat> ReconstructionResult::toMatXYZN() const {
+
+    std::vector<cv::Mat> matVec;
+    matVec.push_back(XCoords);
+    matVec.push_back(YCoords);
+    matVec.push_back(Zcoords);
+    matVec.push_back(Normals);
+    matVec.push_back(Albedo);
+    matVec.push_back(NormalMap);
+    return matVec;
+}
+
+cv::Mat ReconstructionEngine::invertLights(const cv::Mat &lightSrcs, int dropA, int dropB) {
+
+    /* a zeroed light direction yields a zero column, i.e. the light is ignored */
+    cv::Mat subsetSrcs = lightSrcs.clone();
+    if (dropA >= 0) {
+        subsetSrcs.row(dropA).setTo(cv::Scalar::all(0));
+    }
+    if (dropB >= 0) {
+        subsetSrcs.row(dropB).setTo(cv::Scalar::all(0));
+    }
+
+    cv::Mat inv;
+    cv::invert(subsetSrcs, inv, cv::DECOMP_SVD);
+    return inv;
+}
+
+bool ReconstructionEngine::defaultProfiling = false;
+std::string ReconstructionEngine::profileDumpFile;
+std::atomic<int> ReconstructionEngine::numEngines(0);
+const float ReconstructionEngine::MOTION_FRACTION = 0.2f;
+const float ReconstructionEngine::PROCESS_NOISE = 0.25f;
+const float ReconstructionEngine::MAX_SHIFT = 0.125f;
+const double ReconstructionEngine::MIN_RESPONSE = 0.1;
+
+ReconstructionEngine::ReconstructionEngine(int width, int height, int minIntensity) : fastMath(false), halfStorage(false), halfKernels(false), albedoEnabled(false), normalMapEnabled(false), foregroundOnly(false), temporalFilter(false), motionCompensation(false), profiling(defaultProfiling), width(width), height(height), stopping(false) {
+
+    engineIdx = numEngines++;
+
+    /* setup pre calibrated global light sources */
+    cv::Mat lightSrcs = (cv::Mat_<float>(8,3) <<    -0.2222,  0.0074, 0.9749,
+                                                    -0.1629, -0.1407, 0.9765,
+                                                     0.0370, -0.2000, 0.9790,
+                                                     0.1481, -0.1407, 0.9789,
+                                                     0.2222,  0.0296, 0.9745,
+                                                     0.1333,  0.1481, 0.9799,
+                                                    -0.0222,  0.2000, 0.9795,
+                                                    -0.1555,  0.1481, 0.9766);
+
+    /* pseudo-inverses of the full light set, of all sets without one light and
+       of all sets without two lights, stacked in the order expected by ps.cl */
+    lightSrcsInv = cv::Mat(NUM_LIGHT_SUBSETS*3, 8, CV_32F);
+    invertLights(lightSrcs, -1, -1).copyTo(lightSrcsInv.rowRange(0, 3));
+    int subset = 1;
+    for (int a=0; a<8; a++, subset++) {
+        invertLights(lightSrcs, a, -1).copyTo(lightSrcsInv.rowRange(3*subset, 3*subset+3));
+    }
+    for (int a=0; a<8; a++) {
+        for (int b=a+1; b<8; b++, subset++) {
+            invertLights(lightSrcs, a, b).copyTo(lightSrcsInv.rowRange(3*subset, 3*subset+3));
+        }
+    }
+
+    /* initialize non-changing x,y coords of 3d model */
+    XCoords = cv::Mat(height, width, CV_32F, cv::Scalar::all(0));
+    YCoords = cv::Mat(height, width, CV_32F, cv::Scalar::all(0));
+    for (int y=0; y<width; y++) {
+        for (int x=0; x<height; x++) {
+            XCoords.at<float>(x, y) = x;
+            YCoords.at<float>(x, y) = y;
+        }
+    }
+
+    /* adjustable ps parameters */
+    params.maxpq = 10.0f;
+    params.lambda = 0.4f;
+    params.mu = 0.4f;
+    params.minIntensity = minIntensity;
+    params.unsharpScale = 0.0f;
+    params.unsharpRadius = 1;
+    params.robust = false;
+    params.maxIntensity = 250;
+    params.temporalSigma = 0.02f;
+
+    /* initialize OpenCL object and context */
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    cl_context_properties props[] = { CL_CONTEXT_PLATFORM, (cl_context_properties)(platforms[0])(), 0};
+    /* try using CPU, since data is large, computations simple and BUS data transfer is slow */
+    cl_int clError;
+    context = cl::Context(CL_DEVICE_TYPE_CPU, props, NULL, NULL, &clError);
+    if (clError != CL_SUCCESS) {
+        /* fallback to gpu device */
+        context = cl::Context(CL_DEVICE_TYPE_GPU, props, NULL, NULL, &clError);
+    }
+    devices = context.getInfo<CL_CONTEXT_DEVICES>();
+
+    /* create command queue for OpenCL, using first device available */
+    queue = cl::CommandQueue(context, devices[0], profiling ? CL_QUEUE_PROFILING_ENABLE : 0, &error);
+
+    /* load kernel source, programs are built from it on demand */
+    int pl;
+    std::stringstream s;
+    s << PATH_KERNELS << "ps.cl";
+    std::string kernelPath = s.str();
+    char *programCode = OCLUtils::fileContents(kernelPath.data(), &pl);
+    kernelSource = std::string(programCode, pl);
+    free(programCode);
+
+    buildKernels();
+
+    /* creating OpenCL buffers once, dimensions never change; sized for
+       full precision, half precision storage uses their first half */
+    size_t imgSize3 = sizeof(float) * (height*width*3);
+    size_t imgSize4 = sizeof(float) * (height*width*4);
+    size_t gradSize = sizeof(float) * (height*width);
+    size_t sSize = sizeof(float) * (lightSrcsInv.rows*lightSrcsInv.cols*lightSrcsInv.channels());
+    size_t cplxSize = sizeof(float) * (height*width*2); /* 2 channel matrix */
+
+    cl::ImageFormat imgFormat = cl::ImageFormat(CL_INTENSITY, CL_UNORM_INT8);
+
+    cl_img1 = cl::Image2D(context, CL_MEM_READ_ONLY, imgFormat, width, height, 0, NULL, &error);
+    cl_img2 = cl::Image2D(context, CL_MEM_READ_ONLY, imgFormat, width, height, 0, NULL, &error);
+    cl_img3 = cl::Image2D(context, CL_MEM_READ_ONLY, imgFormat, width, height, 0, NULL, &error);
+    cl_img4 = cl::Image2D(context, CL_MEM_READ_ONLY, imgFormat, width, height, 0, NULL, &error);
+    cl_img5 = cl::Image2D(context, CL_MEM_READ_ONLY, imgFormat, width, height, 0, NULL, &error);
+    cl_img6 = cl::Image2D(context, CL_MEM_READ_ONLY, imgFormat, width, height, 0, NULL, &error);
+    cl_img7 = cl::Image2D(context, CL_MEM_READ_ONLY, imgFormat, width, height, 0, NULL, &error);
+    cl_img8 = cl::Image2D(context, CL_MEM_READ_ONLY, imgFormat, width, height, 0, NULL, &error);
+    cl_Sinv = cl::Buffer(context, CL_MEM_READ_ONLY, sSize, NULL, &error);
+    cl_Pgrads = cl::Buffer(context, CL_MEM_READ_WRITE, gradSize, NULL, &error);
+    cl_Qgrads = cl::Buffer(context, CL_MEM_READ_WRITE, gradSize, NULL, &error);
+    cl_N = cl::Buffer(context, CL_MEM_READ_WRITE, imgSize4, NULL, &error);
+    cl_Nout = cl::Buffer(context, CL_MEM_WRITE_ONLY, imgSize3, NULL, &error);
+    cl_Nrows = cl::Buffer(context, CL_MEM_READ_WRITE, imgSize4, NULL, &error);
+    cl_Nbox = cl::Buffer(context, CL_MEM_READ_WRITE, imgSize4, NULL, &error);
+    cl_A = cl::Buffer(context, CL_MEM_WRITE_ONLY, gradSize, NULL, &error);
+    cl_rgb = cl::Buffer(context, CL_MEM_WRITE_ONLY, height*width*3, NULL, &error);
+    cl_P = cl::Buffer(context, CL_MEM_READ_ONLY, cplxSize, NULL, &error);
+    cl_Q = cl::Buffer(context, CL_MEM_READ_ONLY, cplxSize, NULL, &error);
+    cl_Z = cl::Buffer(context, CL_MEM_WRITE_ONLY, cplxSize, NULL, &error);
+
+    /* at most every tile is active, buffers hold no background yet */
+    numTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    numTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    cl_tiles[0] = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(cl_int) * numTilesX*numTilesY, NULL, &error);
+    cl_tiles[1] = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(cl_int) * numTilesX*numTilesY, NULL, &error);
+    cl_numTiles = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(cl_int), NULL, &error);
+    curTiles = 0;
+    numActiveTiles[0] = 0;
+    numActiveTiles[1] = 0;
+    sparseNormals = false;
+    resetAll = true;
+
+    /* filtered state is kept in full precision, it starts from the first filtered set */
+    cl_Ps = cl::Buffer(context, CL_MEM_READ_WRITE, gradSize, NULL, &error);
+    cl_Qs = cl::Buffer(context, CL_MEM_READ_WRITE, gradSize, NULL, &error);
+    cl_Ns = cl::Buffer(context, CL_MEM_READ_WRITE, imgSize4, NULL, &error);
+    cl_var = cl::Buffer(context, CL_MEM_READ_WRITE, gradSize, NULL, &error);
+    cl_moved = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(cl_int) * 2, NULL, &error);
+    cl_int moved[2] = {0, 0};
+    queue.enqueueWriteBuffer(cl_moved, CL_TRUE, 0, sizeof(moved), moved);
+    temporalFrame = 0;
+    temporalReset = true;
+
+    /* images are aligned until motion compensation is enabled */
+    cl_shifts = cl::Buffer(context, CL_MEM_READ_ONLY, sizeof(cl_int2) * 8, NULL, &error);
+    uploadShifts(std::vector<cv::Point>());
+
+    /* light matrix never changes */
+    queue.enqueueWriteBuffer(cl_Sinv, CL_TRUE, 0, sSize, lightSrcsInv.data);
+}
+
+void ReconstructionEngine::buildKernels() {
+
+    bool half = halfStorage;
+    std::string options = buildOptions(fastMath, half);
+
+    /* variants are only built once, switching back and forth is cheap; building
+       takes seconds, sets are reconstructed with the previous kernels meanwhile */
+    cl::Program program;
+    {
+        std::lock_guard<std::mutex> lock(programsMutex);
+        std::map<std::string, cl::Program>::iterator it = programs.find(options);
+        if (it == programs.end()) {
+            cl::Program::Sources source(1, std::make_pair(kernelSource.data(), kernelSource.size()));
+            program = cl::Program(context, source);
+
+            /* build program */
+            program.build(devices, options.c_str());
+            std::cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(devices[0]) << std::endl;
+            std::cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(devices[0]) << std::endl;
+            it = programs.insert(std::make_pair(options, program)).first;
+        }
+        program = it->second;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+    /* options changed again while building, the later call swaps in its kernels */
+    if (options != buildOptions(fastMath, halfStorage) || options == kernelOptions) {
+        return;
+    }
+    /* background stored in the other format */
+    if (half != halfKernels) {
+        resetAll = true;
+    }
+    kernelOptions = options;
+    halfKernels = half;
+
+    /* initialize kernels from program */
+    calcNormKernel = cl::Kernel(program, "calcNormals", &error);
+    integKernel = cl::Kernel(program, "integrate", &error);
+    updateNormKernel = cl::Kernel(program, "updateNormals", &error);
+    boxRowsKernel = cl::Kernel(program, "boxRows", &error);
+    boxColsKernel = cl::Kernel(program, "boxColumns", &error);
+    unsharpKernel = cl::Kernel(program, "unsharpNormals", &error);
+    maskKernel = cl::Kernel(program, "maskTiles", &error);
+    resetKernel = cl::Kernel(program, "resetTiles", &error);
+    motionKernel = cl::Kernel(program, "detectMotion", &error);
+    temporalKernel = cl::Kernel(program, "filterTemporal", &error);
+}
+
+std::string ReconstructionEngine::buildOptions(bool fast, bool half) {
+
+    std::stringstream tileSize;
+    tileSize << " -DTILE_SIZE=" << TILE_SIZE;
+    std::string options = tileSize.str();
+    if (fast) {
+        options += " -cl-fast-relaxed-math";
+    }
+    if (half) {
+        options += " -DHALF_STORAGE";
+    }
+    return options;
+}
+
+ReconstructionEngine::~ReconstructionEngine() {
+
+    /* finishing queued sets before shutting down */
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        stopping = true;
+    }
+    taskQueued.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    if (profiling) {
+        dumpProfile();
+    }
+}
+
+void ReconstructionEngine::dumpProfile() {
+
+    if (!profileDumpFile.empty()) {
+        std::stringstream label;
+        label << width << "x" << height << " #" << engineIdx;
+        profiler.dump(profileDumpFile, label.str());
+    }
+}
+
+ReconstructionParams ReconstructionEngine::getParams() {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    return params;
+}
+
+void ReconstructionEngine::setParams(const ReconstructionParams &params) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    this->params = params;
+}
+
+float ReconstructionEngine::getMaxPQ() {
+    return getParams().maxpq;
+}
+
+void ReconstructionEngine::setMaxPQ(float val) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    params.maxpq = val;
+}
+
+float ReconstructionEngine::getLambda() {
+    return getParams().lambda;
+}
+
+void ReconstructionEngine::setLambda(float val) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    params.lambda = val;
+}
+
+float ReconstructionEngine::getMu() {
+    return getParams().mu;
+}
+
+void ReconstructionEngine::setMu(float val) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    params.mu = val;
+}
+
+int ReconstructionEngine::getMinIntensity() {
+    return getParams().minIntensity;
+}
+
+void ReconstructionEngine::setMinIntensity(int val) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    params.minIntensity = val;
+}
+
+float ReconstructionEngine::getUnsharpScale() {
+    return getParams().unsharpScale;
+}
+
+void ReconstructionEngine::setUnsharpScale(float val) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    params.unsharpScale = val;
+}
+
+void ReconstructionEngine::setProfiling(bool enabled) {
+
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+    if (enabled == profiling) {
+        return;
+    }
+
+    /* profiling is a property of the command queue, buffers and kernels are kept */
+    queue.finish();
+    queue = cl::CommandQueue(context, devices[0], enabled ? CL_QUEUE_PROFILING_ENABLE : 0, &error);
+    profiler.reset();
+    profiling = enabled;
+}
+
+void ReconstructionEngine::setFastMath(bool enabled) {
+
+    if (fastMath.exchange(enabled) != enabled) {
+        buildKernels();
+    }
+}
+
+bool ReconstructionEngine::isFastMath() {
+    return fastMath;
+}
+
+void ReconstructionEngine::setHalfStorage(bool enabled) {
+
+    if (halfStorage.exchange(enabled) != enabled) {
+        buildKernels();
+    }
+}
+
+bool ReconstructionEngine::isHalfStorage() {
+    return halfStorage;
+}
+
+void ReconstructionEngine::setAlbedo(bool enabled) {
+    albedoEnabled = enabled;
+}
+
+bool ReconstructionEngine::isAlbedo() {
+    return albedoEnabled;
+}
+
+void ReconstructionEngine::setNormalMap(bool enabled) {
+    normalMapEnabled = enabled;
+}
+
+bool ReconstructionEngine::isNormalMap() {
+    return normalMapEnabled;
+}
+
+void ReconstructionEngine::setForegroundOnly(bool enabled) {
+    foregroundOnly = enabled;
+}
+
+bool ReconstructionEngine::isForegroundOnly() {
+    return foregroundOnly;
+}
+
+float ReconstructionEngine::getActiveTileShare() {
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+    return sparseNormals ? numActiveTiles[curTiles] / (float)(numTilesX*numTilesY) : 1.0f;
+}
+
+void ReconstructionEngine::setTemporalFilter(bool enabled) {
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+    /* state left over from an earlier run is outdated */
+    if (enabled && !temporalFilter) {
+        temporalReset = true;
+    }
+    temporalFilter = enabled;
+}
+
+bool ReconstructionEngine::isTemporalFilter() {
+    return temporalFilter;
+}
+
+void ReconstructionEngine::setMotionCompensation(bool enabled) {
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+    /* shifts of the last registered set must not apply to later ones */
+    if (!enabled && motionCompensation) {
+        uploadShifts(std::vector<cv::Point>());
+    }
+    motionCompensation = enabled;
+}
+
+bool ReconstructionEngine::isMotionCompensation() {
+    return motionCompensation;
+}
+
+void ReconstructionEngine::resetTemporalFilter() {
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+    temporalReset = true;
+}
+
+void ReconstructionEngine::halfToFloat(const cv::Mat &src, cv::Mat &dst) {
+
+    /* all 2^16 half values widened once, converting is a table lookup then */
+    static std::vector<float> table;
+    static std::once_flag tableInit;
+    std::call_once(tableInit, []() {
+        table.resize(1 << 16);
+        for (uint32_t h=0; h<table.size(); h++) {
+            uint32_t sign = (h & 0x8000) << 16;
+            uint32_t exp = (h >> 10) & 0x1f;
+            uint32_t mant = h & 0x3ff;
+            uint32_t bits;
+            if (exp == 0x1f) {
+                /* inf and nan */
+                bits = sign | 0x7f800000 | (mant << 13);
+            } else if (exp != 0) {
+                bits = sign | ((exp + 112) << 23) | (mant << 13);
+            } else if (mant == 0) {
+                bits = sign;
+            } else {
+                /* subnormal halfs are normal floats */
+                exp = 113;
+                while ((mant & 0x400) == 0) {
+                    mant <<= 1;
+                    exp--;
+                }
+                bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+            }
+            memcpy(&table[h], &bits, sizeof(float));
+        }
+    });
+
+    /* row by row, sparse reads convert regions of the images */
+    dst.create(src.size(), CV_MAKETYPE(CV_32F, src.channels()));
+    int n = src.cols * src.channels();
+    for (int i=0; i<src.rows; i++) {
+        const uint16_t *s = src.ptr<uint16_t>(i);
+        float *d = dst.ptr<float>(i);
+        for (int j=0; j<n; j++) {
+            d[j] = table[s[j]];
+        }
+    }
+}
+
+void ReconstructionEngine::readPixels(const cl::Buffer &buffer, cv::Mat &dst, bool sparse, const char *name) {
+
+    size_t elemSize = dst.elemSize();
+    if (!sparse) {
+        queue.enqueueReadBuffer(buffer, CL_TRUE, 0, elemSize * (height*width), dst.data, NULL, track(name, ClProfiler::TRANSFER));
+        return;
+    }
+
+    /* one rectangular read per span, waited for at once */
+    for (size_t k=0; k<activeSpans.size(); k++) {
+        const cv::Rect &span = activeSpans[k];
+        cl::size_t<3> origin; origin[0] = span.x * elemSize; origin[1] = span.y; origin[2] = 0;
+        cl::size_t<3> region; region[0] = span.width * elemSize; region[1] = span.height; region[2] = 1;
+        queue.enqueueReadBufferRect(buffer, CL_FALSE, origin, origin, region, width * elemSize, 0, dst.step, 0, dst.data, NULL, track(name, ClProfiler::TRANSFER));
+    }
+    queue.finish();
+}
+
+void ReconstructionEngine::readStored(const cl::Buffer &buffer, cv::Mat &dst, bool sparse, const char *name) {
+
+    if (!halfKernels) {
+        readPixels(buffer, dst, sparse, name);
+        return;
+    }
+
+    cv::Mat stored(height, width, CV_16UC(dst.channels()));
+    readPixels(buffer, stored, sparse, name);
+    if (!sparse) {
+        halfToFloat(stored, dst);
+        return;
+    }
+    for (size_t k=0; k<activeSpans.size(); k++) {
+        cv::Mat region = dst(activeSpans[k]);
+        halfToFloat(stored(activeSpans[k]), region);
+    }
+}
+
+bool ReconstructionEngine::isProfiling() {
+    return profiling;
+}
+
+ClProfiler *ReconstructionEngine::getProfiler() {
+    return &profiler;
+}
+
+void ReconstructionEngine::setDefaultProfiling(bool enabled, const std::string &dumpFile) {
+    defaultProfiling = enabled;
+    profileDumpFile = dumpFile;
+}
+
+cl::Event *ReconstructionEngine::track(const char *name, ClProfiler::CommandType type) {
+    return profiling ? profiler.track(name, type) : &event;
+}
+
+int ReconstructionEngine::roundUp(int value, int multiple) {
+    return ((value + multiple - 1) / multiple) * multiple;
+}
+
+int ReconstructionEngine::getUnsharpRadius() {
+    return getParams().unsharpRadius;
+}
+
+void ReconstructionEngine::setUnsharpRadius(int val) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    params.unsharpRadius = std::max(1, val);
+}
+
+bool ReconstructionEngine::getRobust() {
+    return getParams().robust;
+}
+
+void ReconstructionEngine::setRobust(bool val) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    params.robust = val;
+}
+
+int ReconstructionEngine::getMaxIntensity() {
+    return getParams().maxIntensity;
+}
+
+void ReconstructionEngine::setMaxIntensity(int val) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    params.maxIntensity = val;
+}
+
+float ReconstructionEngine::getTemporalSigma() {
+    return getParams().temporalSigma;
+}
+
+void ReconstructionEngine::setTemporalSigma(float val) {
+    std::lock_guard<std::mutex> lock(paramsMutex);
+    params.temporalSigma = std::max(0.001f, val);
+}
+
+int ReconstructionEngine::getWidth() {
+    return width;
+}
+
+int ReconstructionEngine::getHeight() {
+    return height;
+}
+
+cv::Mat ReconstructionEngine::readCalibratedLights() {
+
+    cv::Mat lightsInv = cv::Mat(height, width, CV_32FC(24), cv::Scalar::all(0));
+
+    std::stringstream lmp;
+    lmp << PATH_ASSETS << "lightMat.kaw";
+
+    FILE *kawFile = fopen(lmp.str().c_str(), "rb");
+    if (kawFile == NULL) {
+        std::cerr << "ERROR: Could not open calibrated light matrix." << std::endl;
+        return lightsInv;
+    }
+
+    /* get file size */
+    long fSize;
+    size_t res;
+    fseek(kawFile, 0, SEEK_END);
+    fSize = ftell(kawFile);
+    rewind(kawFile);
+
+    /* reading data */
+    res = fread(lightsInv.data, 1, sizeof(float)*height*width*lightsInv.channels(), kawFile);
+    if (res != fSize) {
+        std::cerr << "ERROR: Error while reading calibrated light matrix in" << std::endl;
+    }
+    fclose(kawFile);
+
+    return lightsInv;
+}
+
+std::future<ReconstructionResult> ReconstructionEngine::submit(const FrameSet &frameSet) {
+
+    std::lock_guard<std::mutex> lock(tasksMutex);
+
+    /* worker is only started once it is actually needed */
+    if (!worker.joinable()) {
+        worker = std::thread(&ReconstructionEngine::processTasks, this);
+    }
+
+    tasks.push_back(Task());
+    tasks.back().frameSet = frameSet;
+    std::future<ReconstructionResult> result = tasks.back().result.get_future();
+    taskQueued.notify_one();
+
+    return result;
+}
+
+void ReconstructionEngine::processTasks() {
+
+    Trace::setThreadName("ReconstructionEngine worker");
+
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(tasksMutex);
+            while (tasks.empty() && !stopping) {
+                taskQueued.wait(lock);
+            }
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        try {
+            task.result.set_value(reconstruct(task.frameSet));
+        } catch (...) {
+            task.result.set_exception(std::current_exception());
+        }
+    }
+}
+
+ReconstructionResult ReconstructionEngine::reconstruct(const FrameSet &images) {
+
+    TRACE_SCOPE("ReconstructionEngine::reconstruct");
+
+    /* measuring ps performance */
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    /* parameters might be changed by the user while reconstructing */
+    ReconstructionParams p = getParams();
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+
+    cv::Mat Normals(height, width, CV_32FC3);
+    cv::Mat Pgrads(height, width, CV_32F);
+    cv::Mat Qgrads(height, width, CV_32F);
+
+    cv::Mat Albedo;
+    if (albedoEnabled) {
+        Albedo.create(height, width, CV_32F);
+    }
+
+    cv::Mat NormalMap;
+    if (normalMapEnabled) {
+        NormalMap.create(height, width, CV_8UC3);
+    }
+
+    if (motionCompensation) {
+        uploadShifts(registerImages(images));
+    }
+    uploadImages(images);
+    calcNormals(p, Pgrads, Qgrads, Albedo);
+
+    /* integrate and get heights globally */
+    cv::Mat Zcoords = getGlobalHeights(Pgrads, Qgrads, p);
+
+    /*  unsharp masking as in [Malzbender2006] */
+    updateNormals(p, Normals, NormalMap);
+
+    /* integrate updated gradients second time */
+    Zcoords = getGlobalHeights(Pgrads, Qgrads, p);
+
+    /* dumping periodically as well, engines may live until the process is killed */
+    if (profiling && profiler.endFrame() % PROFILE_DUMP_INTERVAL == 0) {
+        dumpProfile();
+    }
+
+    /* store 3d data and normals */
+    ReconstructionResult result;
+    result.XCoords = XCoords;
+    result.YCoords = YCoords;
+    result.Zcoords = Zcoords;
+    result.Normals = Normals;
+    result.Albedo = Albedo;
+    result.NormalMap = NormalMap;
+    result.elapsedMillis = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    return result;
+}
+
+std::vector<cv::Point> ReconstructionEngine::registerImages(const FrameSet &images) {
+
+    TRACE_SCOPE("ReconstructionEngine::registerImages");
+
+    /* registering small copies keeps the cost independent of the resolution,
+       the window suppresses the edges of the images in the spectrum */
+    cv::Size size(REGISTRATION_SIZE, REGISTRATION_SIZE);
+    cv::Mat window;
+    cv::createHanningWindow(window, size, CV_32F);
+
+    std::vector<cv::Mat> small(images.size());
+    for (size_t k=0; k<images.size(); k++) {
+        cv::Mat resized;
+        cv::resize(images.at(k), resized, size, 0, 0, cv::INTER_AREA);
+        resized.convertTo(small[k], CV_32F);
+    }
+
+    double scaleX = width / (double)REGISTRATION_SIZE;
+    double scaleY = height / (double)REGISTRATION_SIZE;
+    std::vector<cv::Point> shifts(images.size(), cv::Point(0, 0));
+    for (size_t k=1; k<images.size(); k++) {
+        double response = 0;
+        cv::Point2d d = cv::phaseCorrelateRes(small[0], small[k], window, &response);
+        /* weak peaks and peaks this far off are rather caused by featureless
+           images or the changing light than by motion */
+        if (response < MIN_RESPONSE || std::fabs(d.x) > MAX_SHIFT*REGISTRATION_SIZE || std::fabs(d.y) > MAX_SHIFT*REGISTRATION_SIZE) {
+            continue;
+        }
+
+        /* sub-pixel jitter of still objects must not round to a full pixel */
+        double dx = d.x * scaleX;
+        double dy = d.y * scaleY;
+        shifts[k] = cv::Point(std::fabs(dx) < 0.5 ? 0 : cvRound(dx), std::fabs(dy) < 0.5 ? 0 : cvRound(dy));
+    }
+
+    return shifts;
+}
+
+void ReconstructionEngine::uploadShifts(const std::vector<cv::Point> &shifts) {
+
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+
+    cl_int2 s[8];
+    for (int k=0; k<8; k++) {
+        s[k].s[0] = (k < (int)shifts.size()) ? shifts[k].x : 0;
+        s[k].s[1] = (k < (int)shifts.size()) ? shifts[k].y : 0;
+    }
+    queue.enqueueWriteBuffer(cl_shifts, CL_TRUE, 0, sizeof(s), s, NULL, track("write shifts", ClProfiler::TRANSFER));
+}
+
+void ReconstructionEngine::uploadImages(const FrameSet &images) {
+
+    TRACE_SCOPE("ReconstructionEngine::uploadImages");
+
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+
+    cl::size_t<3> origin; origin[0] = 0; origin[1] = 0; origin[2] = 0;
+    cl::size_t<3> region; region[0] = width; region[1] = height; region[2] = 1;
+
+    queue.enqueueWriteImage(cl_img1, CL_TRUE, origin, region, 0, 0, images.at(0).data, NULL, track("write image", ClProfiler::TRANSFER));
+    queue.enqueueWriteImage(cl_img2, CL_TRUE, origin, region, 0, 0, images.at(1).data, NULL, track("write image", ClProfiler::TRANSFER));
+    queue.enqueueWriteImage(cl_img3, CL_TRUE, origin, region, 0, 0, images.at(2).data, NULL, track("write image", ClProfiler::TRANSFER));
+    queue.enqueueWriteImage(cl_img4, CL_TRUE, origin, region, 0, 0, images.at(3).data, NULL, track("write image", ClProfiler::TRANSFER));
+    queue.enqueueWriteImage(cl_img5, CL_TRUE, origin, region, 0, 0, images.at(4).data, NULL, track("write image", ClProfiler::TRANSFER));
+    queue.enqueueWriteImage(cl_img6, CL_TRUE, origin, region, 0, 0, images.at(5).data, NULL, track("write image", ClProfiler::TRANSFER));
+    queue.enqueueWriteImage(cl_img7, CL_TRUE, origin, region, 0, 0, images.at(6).data, NULL, track("write image", ClProfiler::TRANSFER));
+    queue.enqueueWriteImage(cl_img8, CL_TRUE, origin, region, 0, 0, images.at(7).data, NULL, track("write image", ClProfiler::TRANSFER));
+}
+
+void ReconstructionEngine::calcNormals(const ReconstructionParams &p, cv::Mat &Pgrads, cv::Mat &Qgrads, cv::Mat Albedo) {
+
+    TRACE_SCOPE("ReconstructionEngine::calcNormals");
+
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+
+    /* set kernel arguments */
+    calcNormKernel.setArg(0, cl_img1); // 1-8 images
+    calcNormKernel.setArg(1, cl_img2);
+    calcNormKernel.setArg(2, cl_img3);
+    calcNormKernel.setArg(3, cl_img4);
+    calcNormKernel.setArg(4, cl_img5);
+    calcNormKernel.setArg(5, cl_img6);
+    calcNormKernel.setArg(6, cl_img7);
+    calcNormKernel.setArg(7, cl_img8);
+    calcNormKernel.setArg(8, width); // required for..
+    calcNormKernel.setArg(9, height); // ..determining array dimensions
+    calcNormKernel.setArg(10, cl_Sinv); // inverse of light matrix
+    calcNormKernel.setArg(11, cl_Pgrads); // P gradients
+    calcNormKernel.setArg(12, cl_Qgrads); // Q gradients
+    calcNormKernel.setArg(13, cl_N); // normals for each point
+    calcNormKernel.setArg(14, p.maxpq); // max depth gradients as in [Wei2001]
+    calcNormKernel.setArg(15, p.minIntensity); // exaggerate slope as in [Malzbender2006]
+    calcNormKernel.setArg(16, cl_A); // albedo, written..
+    calcNormKernel.setArg(17, Albedo.empty() ? 0 : 1); // ..if requested
+    calcNormKernel.setArg(18, p.robust ? 1 : 0); // dropping shadowed and specular lights
+    calcNormKernel.setArg(19, p.maxIntensity); // specular highlight threshold
+
+    /* listing foreground tiles and resetting the previous ones ahead of the normals */
+    sparseNormals = foregroundOnly;
+    if (sparseNormals) {
+        maskTiles(p);
+    }
+    calcNormKernel.setArg(20, cl_tiles[curTiles]); // active tiles..
+    calcNormKernel.setArg(21, sparseNormals ? 1 : 0); // ..processed if sparse
+    calcNormKernel.setArg(22, cl_shifts); // motion between the images
+
+    /* wait for command queue to finish before continuing */
+    queue.finish();
+
+    /* executing kernel, sparse over one work-group per active tile */
+    if (!sparseNormals) {
+        queue.enqueueNDRangeKernel(calcNormKernel, cl::NullRange, cl::NDRange(height, width), cl::NullRange, NULL, track("calcNormals", ClProfiler::KERNEL));
+        resetAll = true;
+    } else if (numActiveTiles[curTiles] > 0) {
+        cl::NDRange global(numActiveTiles[curTiles]*TILE_SIZE, TILE_SIZE);
+        queue.enqueueNDRangeKernel(calcNormKernel, cl::NullRange, global, cl::NDRange(TILE_SIZE, TILE_SIZE), NULL, track("calcNormals", ClProfiler::KERNEL));
+    }
+
+    /* filtered in place ahead of reading back, unsharp masking sharpens the filtered normals */
+    if (temporalFilter) {
+        filterTemporal(p);
+    }
+    queue.finish();
+
+    /* reading back from CPU device, only the active tiles of sparse sets as the
+       others hold background, which is filled in on the host */
+    if (sparseNormals) {
+        Pgrads.setTo(cv::Scalar::all(0));
+        Qgrads.setTo(cv::Scalar::all(0));
+        if (!Albedo.empty()) {
+            Albedo.setTo(cv::Scalar::all(0));
+        }
+    }
+    readStored(cl_Pgrads, Pgrads, sparseNormals, "read gradients");
+    readStored(cl_Qgrads, Qgrads, sparseNormals, "read gradients");
+    if (!Albedo.empty()) {
+        readPixels(cl_A, Albedo, sparseNormals, "read albedo");
+    }
+
+    if (profiling) {
+        profiler.collect();
+    }
+}
+
+void ReconstructionEngine::maskTiles(const ReconstructionParams &p) {
+
+    TRACE_SCOPE("ReconstructionEngine::maskTiles");
+
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+
+    /* lists of the current and the previous set alternate */
+    int prevTiles = curTiles;
+    curTiles = 1 - curTiles;
+
+    cl_int numTiles = 0;
+    queue.enqueueWriteBuffer(cl_numTiles, CL_TRUE, 0, sizeof(cl_int), &numTiles, NULL, track("write tile count", ClProfiler::TRANSFER));
+
+    maskKernel.setArg(0, cl_img1); // 1-8 images
+    maskKernel.setArg(1, cl_img2);
+    maskKernel.setArg(2, cl_img3);
+    maskKernel.setArg(3, cl_img4);
+    maskKernel.setArg(4, cl_img5);
+    maskKernel.setArg(5, cl_img6);
+    maskKernel.setArg(6, cl_img7);
+    maskKernel.setArg(7, cl_img8);
+    maskKernel.setArg(8, width);
+    maskKernel.setArg(9, height);
+    maskKernel.setArg(10, p.minIntensity);
+    maskKernel.setArg(11, p.robust ? 7 : 8); // robust mode tolerates a single shadow
+    maskKernel.setArg(12, cl_tiles[curTiles]);
+    maskKernel.setArg(13, cl_numTiles);
+    maskKernel.setArg(14, cl_shifts);
+
+    cl::NDRange global(roundUp(height, TILE_SIZE), roundUp(width, TILE_SIZE));
+    queue.enqueueNDRangeKernel(maskKernel, cl::NullRange, global, cl::NDRange(TILE_SIZE, TILE_SIZE), NULL, track("maskTiles", ClProfiler::KERNEL));
+
+    /* length of the list sizes the sparse ranges, the list itself the sparse reads */
+    queue.enqueueReadBuffer(cl_numTiles, CL_TRUE, 0, sizeof(cl_int), &numTiles, NULL, track("read tile count", ClProfiler::TRANSFER));
+    numActiveTiles[curTiles] = numTiles;
+    std::vector<cl_int> tiles(numTiles);
+    if (numTiles > 0) {
+        queue.enqueueReadBuffer(cl_tiles[curTiles], CL_TRUE, 0, sizeof(cl_int) * numTiles, tiles.data(), NULL, track("read tiles", ClProfiler::TRANSFER));
+    }
+
+    /* tiles are listed in any order, neighbours in a row are read as one span */
+    std::sort(tiles.begin(), tiles.end());
+    activeSpans.clear();
+    for (size_t k=0; k<tiles.size(); ) {
+        size_t end = k+1;
+        while (end < tiles.size() && tiles[end] == tiles[end-1]+1 && tiles[end] % numTilesX != 0) {
+            end++;
+        }
+        int y = (tiles[k] / numTilesX) * TILE_SIZE;
+        int x = (tiles[k] % numTilesX) * TILE_SIZE;
+        int w = std::min((int)(end-k) * TILE_SIZE, width - x);
+        activeSpans.push_back(cv::Rect(x, y, w, std::min(TILE_SIZE, height - y)));
+        k = end;
+    }
+
+    /* tiles of the previous set are reset, all others hold background already */
+    resetKernel.setArg(0, cl_tiles[prevTiles]);
+    resetKernel.setArg(1, resetAll ? 0 : 1);
+    resetKernel.setArg(2, width);
+    resetKernel.setArg(3, height);
+    resetKernel.setArg(4, cl_Pgrads);
+    resetKernel.setArg(5, cl_Qgrads);
+    resetKernel.setArg(6, cl_N);
+    resetKernel.setArg(7, cl_Nout);
+    resetKernel.setArg(8, cl_A);
+    resetKernel.setArg(9, cl_rgb);
+    if (resetAll) {
+        queue.enqueueNDRangeKernel(resetKernel, cl::NullRange, global, cl::NDRange(TILE_SIZE, TILE_SIZE), NULL, track("resetTiles", ClProfiler::KERNEL));
+        resetAll = false;
+    } else if (numActiveTiles[prevTiles] > 0) {
+        cl::NDRange prevGlobal(numActiveTiles[prevTiles]*TILE_SIZE, TILE_SIZE);
+        queue.enqueueNDRangeKernel(resetKernel, cl::NullRange, prevGlobal, cl::NDRange(TILE_SIZE, TILE_SIZE), NULL, track("resetTiles", ClProfiler::KERNEL));
+    }
+}
+
+void ReconstructionEngine::filterTemporal(const ReconstructionParams &p) {
+
+    TRACE_SCOPE("ReconstructionEngine::filterTemporal");
+
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+
+    /* measurement and process noise as variances */
+    float r = p.temporalSigma * p.temporalSigma;
+    float q = r * PROCESS_NOISE * PROCESS_NOISE;
+
+    /* same range as calcNormals, background tiles of sparse sets are left untouched */
+    cl::NDRange global(roundUp(height, TILE_SIZE), roundUp(width, TILE_SIZE));
+    int numPixels = width*height;
+    if (sparseNormals) {
+        global = cl::NDRange(numActiveTiles[curTiles]*TILE_SIZE, TILE_SIZE);
+        numPixels = numActiveTiles[curTiles]*TILE_SIZE*TILE_SIZE;
+    }
+    if (numPixels == 0) {
+        return;
+    }
+
+    motionKernel.setArg(0, cl_N);
+    motionKernel.setArg(1, cl_Ns);
+    motionKernel.setArg(2, cl_var);
+    motionKernel.setArg(3, width);
+    motionKernel.setArg(4, height);
+    motionKernel.setArg(5, r);
+    motionKernel.setArg(6, q);
+    motionKernel.setArg(7, cl_moved);
+    motionKernel.setArg(8, temporalFrame);
+    motionKernel.setArg(9, cl_tiles[curTiles]);
+    motionKernel.setArg(10, sparseNormals ? 1 : 0);
+    queue.enqueueNDRangeKernel(motionKernel, cl::NullRange, global, cl::NDRange(TILE_SIZE, TILE_SIZE), NULL, track("detectMotion", ClProfiler::KERNEL));
+
+    /* the count of moving pixels stays on the device, it is evaluated by the filter itself */
+    temporalKernel.setArg(0, cl_Pgrads);
+    temporalKernel.setArg(1, cl_Qgrads);
+    temporalKernel.setArg(2, cl_N);
+    temporalKernel.setArg(3, cl_Ps);
+    temporalKernel.setArg(4, cl_Qs);
+    temporalKernel.setArg(5, cl_Ns);
+    temporalKernel.setArg(6, cl_var);
+    temporalKernel.setArg(7, width);
+    temporalKernel.setArg(8, height);
+    temporalKernel.setArg(9, r);
+    temporalKernel.setArg(10, q);
+    temporalKernel.setArg(11, (int)(MOTION_FRACTION * numPixels));
+    temporalKernel.setArg(12, cl_moved);
+    temporalKernel.setArg(13, temporalFrame);
+    temporalKernel.setArg(14, temporalReset ? 1 : 0);
+    temporalKernel.setArg(15, cl_tiles[curTiles]);
+    temporalKernel.setArg(16, sparseNormals ? 1 : 0);
+    queue.enqueueNDRangeKernel(temporalKernel, cl::NullRange, global, cl::NDRange(TILE_SIZE, TILE_SIZE), NULL, track("filterTemporal", ClProfiler::KERNEL));
+
+    temporalFrame++;
+    temporalReset = false;
+}
+
+void ReconstructionEngine::updateNormals(const ReconstructionParams &p, cv::Mat &Normals, cv::Mat NormalMap) {
+
+    TRACE_SCOPE("ReconstructionEngine::updateNormals");
+
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+
+    if (p.unsharpRadius <= 1) {
+        updateNormKernel.setArg(0, cl_N);
+        updateNormKernel.setArg(1, cl_Nout);
+        updateNormKernel.setArg(2, width);
+        updateNormKernel.setArg(3, height);
+        updateNormKernel.setArg(4, p.unsharpScale);
+        updateNormKernel.setArg(5, cl_tiles[curTiles]);
+        updateNormKernel.setArg(6, sparseNormals ? 1 : 0);
+        updateNormKernel.setArg(7, cl_rgb); // normal map..
+        updateNormKernel.setArg(8, NormalMap.empty() ? 0 : 1); // ..if requested
+
+        /* executing tiled kernel updating normals, range rounded up to full tiles
+           or over the active tiles only, the others hold background already */
+        if (!sparseNormals) {
+            cl::NDRange global(roundUp(height, TILE_SIZE), roundUp(width, TILE_SIZE));
+            queue.enqueueNDRangeKernel(updateNormKernel, cl::NullRange, global, cl::NDRange(TILE_SIZE, TILE_SIZE), NULL, track("updateNormals", ClProfiler::KERNEL));
+        } else if (numActiveTiles[curTiles] > 0) {
+            cl::NDRange global(numActiveTiles[curTiles]*TILE_SIZE, TILE_SIZE);
+            queue.enqueueNDRangeKernel(updateNormKernel, cl::NullRange, global, cl::NDRange(TILE_SIZE, TILE_SIZE), NULL, track("updateNormals", ClProfiler::KERNEL));
+        }
+    } else {
+        /* box filter reaches beyond the active tiles, background is reset next time */
+        resetAll = true;
+
+        /* box filtering rows, then columns */
+        boxRowsKernel.setArg(0, cl_N);
+        boxRowsKernel.setArg(1, cl_Nrows);
+        boxRowsKernel.setArg(2, width);
+        boxRowsKernel.setArg(3, height);
+        boxRowsKernel.setArg(4, p.unsharpRadius);
+        queue.enqueueNDRangeKernel(boxRowsKernel, cl::NullRange, cl::NDRange(height), cl::NullRange, NULL, track("boxRows", ClProfiler::KERNEL));
+
+        boxColsKernel.setArg(0, cl_Nrows);
+        boxColsKernel.setArg(1, cl_Nbox);
+        boxColsKernel.setArg(2, width);
+        boxColsKernel.setArg(3, height);
+        boxColsKernel.setArg(4, p.unsharpRadius);
+        queue.enqueueNDRangeKernel(boxColsKernel, cl::NullRange, cl::NDRange(width), cl::NullRange, NULL, track("boxColumns", ClProfiler::KERNEL));
+
+        unsharpKernel.setArg(0, cl_N);
+        unsharpKernel.setArg(1, cl_Nbox);
+        unsharpKernel.setArg(2, cl_Nout);
+        unsharpKernel.setArg(3, width);
+        unsharpKernel.setArg(4, height);
+        unsharpKernel.setArg(5, p.unsharpScale);
+        unsharpKernel.setArg(6, cl_rgb);
+        unsharpKernel.setArg(7, NormalMap.empty() ? 0 : 1);
+        queue.enqueueNDRangeKernel(unsharpKernel, cl::NullRange, cl::NDRange(height, width), cl::NullRange, NULL, track("unsharpNormals", ClProfiler::KERNEL));
+    }
+    queue.finish();
+
+    /* reading back from CPU device, sparse as calcNormals unless the box filter
+       wrote all normals; background as written by resetTiles */
+    bool sparse = sparseNormals && p.unsharpRadius <= 1;
+    if (sparse) {
+        Normals.setTo(cv::Scalar(0, 0, 1));
+        if (!NormalMap.empty()) {
+            NormalMap.setTo(cv::Scalar(128, 128, 255));
+        }
+    }
+    readStored(cl_Nout, Normals, sparse, "read normals");
+    if (!NormalMap.empty()) {
+        readPixels(cl_rgb, NormalMap, sparse, "read normal map");
+    }
+
+    if (profiling) {
+        profiler.collect();
+    }
+}
+
+cv::Mat ReconstructionEngine::getGlobalHeights(cv::Mat Pgrads, cv::Mat Qgrads, const ReconstructionParams &p) {
+
+    TRACE_SCOPE("ReconstructionEngine::getGlobalHeights");
+
+    cv::Mat P(Pgrads.rows, Pgrads.cols, CV_32FC2, cv::Scalar::all(0));
+    cv::Mat Q(Pgrads.rows, Pgrads.cols, CV_32FC2, cv::Scalar::all(0));
+    cv::Mat Z(Pgrads.rows, Pgrads.cols, CV_32FC2, cv::Scalar::all(0));
+
+    {
+        TRACE_SCOPE("ReconstructionEngine::dft");
+        cv::dft(Pgrads, P, cv::DFT_COMPLEX_OUTPUT);
+        cv::dft(Qgrads, Q, cv::DFT_COMPLEX_OUTPUT);
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(deviceMutex);
+    size_t imgSize = sizeof(float) * (height*width*2); /* 2 channel matrix */
+
+    /* pushing data to CPU */
+    queue.enqueueWriteBuffer(cl_P, CL_TRUE, 0, imgSize, P.data, NULL, track("write spectra", ClProfiler::TRANSFER));
+    queue.enqueueWriteBuffer(cl_Q, CL_TRUE, 0, imgSize, Q.data, NULL, track("write spectra", ClProfiler::TRANSFER));
+    queue.enqueueWriteBuffer(cl_Z, CL_TRUE, 0, imgSize, Z.data, NULL, track("write spectra", ClProfiler::TRANSFER));
+
+    /* set kernel arguments */
+    integKernel.setArg(0, cl_P);
+    integKernel.setArg(1, cl_Q);
+    integKernel.setArg(2, cl_Z);
+    integKernel.setArg(3, width);
+    integKernel.setArg(4, height);
+    integKernel.setArg(5, p.lambda);
+    integKernel.setArg(6, p.mu);
+    /* wait for command queue to finish before continuing */
+    queue.finish();
+
+    /* executing kernel */
+    queue.enqueueNDRangeKernel(integKernel, cl::NullRange, cl::NDRange(height, width), cl::NullRange, NULL, track("integrate", ClProfiler::KERNEL));
+
+    /* reading back from CPU */
+    queue.enqueueReadBuffer(cl_Z, CL_TRUE, 0, imgSize, Z.data, NULL, track("read heights", ClProfiler::TRANSFER));
+
+    if (profiling) {
+        profiler.collect();
+    }
+
+    /* setting unknown average height to zero */
+    Z.at<cv::Vec2f>(0, 0)[0] = 0.0f;
+    Z.at<cv::Vec2f>(0, 0)[1] = 0.0f;
+
+    {
+        TRACE_SCOPE("ReconstructionEngine::idft");
+        cv::dft(Z, Z, cv::DFT_INVERSE | cv::DFT_SCALE |  cv::DFT_REAL_OUTPUT);
+    }
+
+    return Z;
+}
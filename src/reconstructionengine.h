@@ -0,0 +1,307 @@
+#ifndef RECONSTRUCTION_ENGINE_H
+#define RECONSTRUCTION_ENGINE_H
+
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <cstring>
+#include <stdint.h>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "OpenCL/cl.hpp"
+#include "oclutils.h"
+#include "clprofiler.h"
+#include "trace.h"
+#include "config.h"
+
+/** eight ambient subtracted 8-bit images, one per led */
+typedef std::vector<cv::Mat> FrameSet;
+
+/** 3d model of one reconstruction */
+struct ReconstructionResult {
+    cv::Mat XCoords, YCoords, Zcoords;
+    cv::Mat Normals;
+    /** per pixel albedo in intensity units, empty unless enabled */
+    cv::Mat Albedo;
+    /** normals encoded as (n+1)/2 in 8-bit rgb for display, empty unless enabled */
+    cv::Mat NormalMap;
+    /** wall clock time of the reconstruction in milliseconds */
+    long elapsedMillis;
+
+    /** xyz-coords, normals, albedo and normal map structured as a tensor, as
+     * consumed by the widgets; the latter two are empty if not enabled */
+    std::vector<cv::Mat> toMatXYZN() const;
+};
+
+/** User adjustable parameters of a reconstruction */
+struct ReconstructionParams {
+    /** max depth gradients as in [Wei2001] */
+    float maxpq;
+    /** regularization of the global integration */
+    float lambda, mu;
+    /** pixels darker than this in any image are treated as background */
+    int minIntensity;
+    /** unsharp masking of normals as in [Malzbender2006] */
+    float unsharpScale;
+    /** radius of the neighbourhood the normals are sharpened against */
+    int unsharpRadius;
+    /** robust mode ignores a single shadowed light (below minIntensity) and a
+     * specular highlight (at or above maxIntensity) instead of rejecting the pixel */
+    bool robust;
+    int maxIntensity;
+    /** expected deviation of normals between consecutive sets of a still scene,
+     * larger values filter more strongly and tolerate more before taken as motion */
+    float temporalSigma;
+};
+
+/** Photometric stereo reconstruction using OpenCL, independent of Qt. Sets
+ * are either reconstructed synchronously with reconstruct() or queued with
+ * submit() and processed in order on the engine's own worker thread. */
+class ReconstructionEngine {
+
+public:
+    ReconstructionEngine(int width, int height, int minIntensity);
+    ~ReconstructionEngine();
+    /** Queue set for reconstruction on the worker thread */
+    std::future<ReconstructionResult> submit(const FrameSet &frameSet);
+    /** Reconstruct set in the calling thread, calls are serialized */
+    ReconstructionResult reconstruct(const FrameSet &frameSet);
+
+    ReconstructionParams getParams();
+    void setParams(const ReconstructionParams &params);
+    float getMaxPQ();
+    void setMaxPQ(float val);
+    float getLambda();
+    void setLambda(float val);
+    float getMu();
+    void setMu(float val);
+    int getMinIntensity();
+    void setMinIntensity(int val);
+    float getUnsharpScale();
+    void setUnsharpScale(float val);
+    int getUnsharpRadius();
+    void setUnsharpRadius(int val);
+    bool getRobust();
+    void setRobust(bool val);
+    int getMaxIntensity();
+    void setMaxIntensity(int val);
+    float getTemporalSigma();
+    void setTemporalSigma(float val);
+    int getWidth();
+    int getHeight();
+
+    /** Kernels compiled with -cl-fast-relaxed-math, trading accuracy for speed;
+     * built in the calling thread, sets are reconstructed with the previous
+     * kernels until they are swapped in */
+    void setFastMath(bool enabled);
+    bool isFastMath();
+    /** Normals and depth gradients stored and transferred as fp16, arithmetic
+     * and integration stay fp32; results are widened to fp32 on the host */
+    void setHalfStorage(bool enabled);
+    bool isHalfStorage();
+    /** Albedo computed along with the normals, appended to the results */
+    void setAlbedo(bool enabled);
+    bool isAlbedo();
+    /** Display ready normal map written along with the final normals */
+    void setNormalMap(bool enabled);
+    bool isNormalMap();
+    /** Normals only computed for tiles holding foreground (pixels not rejected
+     * by minIntensity), the remaining tiles are reset to background */
+    void setForegroundOnly(bool enabled);
+    bool isForegroundOnly();
+    /** Share of the tiles processed by the last calcNormals(), 1 unless foreground only */
+    float getActiveTileShare();
+    /** Images 2..8 of each set registered onto the first one by phase correlation
+     * of downsampled copies, compensating translations of the object */
+    void setMotionCompensation(bool enabled);
+    bool isMotionCompensation();
+    /** Gradients and normals of each set blended with those of the previous sets
+     * on the device, restarting where the scene moved and entirely once a large
+     * part of it did */
+    void setTemporalFilter(bool enabled);
+    bool isTemporalFilter();
+    /** Next set restarts the temporal filter, e.g. after jumping in a replay */
+    void resetTemporalFilter();
+
+    /** Device side timing of every transfer and kernel, recreates the command queue */
+    void setProfiling(bool enabled);
+    bool isProfiling();
+    ClProfiler *getProfiler();
+    /** Profiling engines created from now on, which append their statistics to
+     * dumpFile (if not empty) when destroyed */
+    static void setDefaultProfiling(bool enabled, const std::string &dumpFile = std::string());
+
+    /* individual pipeline stages as run by reconstruct(), exposed for benchmarking */
+    /** Shifts of the images against the first one, as passed to the kernels by
+     * reconstruct(); zero where no reliable shift was found */
+    std::vector<cv::Point> registerImages(const FrameSet &frameSet);
+    void uploadImages(const FrameSet &frameSet);
+    /** Depth gradients of the uploaded images, normals are kept on the device;
+     * albedo is written to Albedo if it is allocated */
+    void calcNormals(const ReconstructionParams &p, cv::Mat &Pgrads, cv::Mat &Qgrads, cv::Mat Albedo = cv::Mat());
+    /** Global integration of depth gradients in the frequency domain */
+    cv::Mat getGlobalHeights(cv::Mat Pgrads, cv::Mat Qgrads, const ReconstructionParams &p);
+    /** Unsharp masking of the normals computed by the last calcNormals(), radius 1
+     * uses a tiled 3x3 kernel, larger radii separable running sums; the rgb
+     * normal map is written to NormalMap if it is allocated */
+    void updateNormals(const ReconstructionParams &p, cv::Mat &Normals, cv::Mat NormalMap = cv::Mat());
+
+private:
+    /* device variables */
+    std::vector<cl::Device> devices;
+    /* kernel source and programs built from it, by build options */
+    std::string kernelSource;
+    std::map<std::string, cl::Program> programs;
+    std::mutex programsMutex;
+    /* options as requested, the kernels in use follow once built */
+    std::atomic<bool> fastMath;
+    std::atomic<bool> halfStorage;
+    /* options of the kernels in use, guarded by deviceMutex */
+    std::string kernelOptions;
+    bool halfKernels;
+    /* outputs of the next reconstruction, read once per set */
+    std::atomic<bool> albedoEnabled;
+    std::atomic<bool> normalMapEnabled;
+    std::atomic<bool> foregroundOnly;
+    bool temporalFilter;
+    bool motionCompensation;
+    cl::Context context;
+    cl::CommandQueue queue;
+    cl::Kernel calcNormKernel, integKernel, updateNormKernel;
+    cl::Kernel boxRowsKernel, boxColsKernel, unsharpKernel;
+    cl::Kernel maskKernel, resetKernel;
+    cl::Kernel motionKernel, temporalKernel;
+
+    /* opencl buffer */
+    cl::Image2D cl_img1, cl_img2, cl_img3, cl_img4, cl_img5, cl_img6, cl_img7, cl_img8;
+    cl::Buffer cl_Pgrads, cl_Qgrads;
+    cl::Buffer cl_Sinv;
+    /* float4 normals of calcNormals, tightly packed float3 normals of updateNormals */
+    cl::Buffer cl_N, cl_Nout;
+    /* row sums and box filtered normals for larger unsharp radii */
+    cl::Buffer cl_Nrows, cl_Nbox;
+    cl::Buffer cl_A;
+    /* 8-bit rgb normal map */
+    cl::Buffer cl_rgb;
+    cl::Buffer cl_P, cl_Q, cl_Z;
+    /* lists of active tiles of the current and the previous set, and their length */
+    cl::Buffer cl_tiles[2], cl_numTiles;
+    /* temporally filtered gradients, float4 normals and their variance, and the
+       moving pixels of the current and the next set */
+    cl::Buffer cl_Ps, cl_Qs, cl_Ns, cl_var, cl_moved;
+    /* int2 shift of each image against the first one */
+    cl::Buffer cl_shifts;
+
+    /* debugging variables */
+    cl_int error;
+    cl::Event event;
+
+    /* opencl event profiling */
+    ClProfiler profiler;
+    bool profiling;
+    int engineIdx;
+    static bool defaultProfiling;
+    static std::string profileDumpFile;
+    static std::atomic<int> numEngines;
+    /** Event to enqueue a command with, tracked by the profiler if enabled */
+    cl::Event *track(const char *name, ClProfiler::CommandType type);
+    /* reconstructions between appending the statistics to the dump file */
+    static const long PROFILE_DUMP_INTERVAL = 100;
+    /** Appending the statistics to the dump file, if one is given */
+    void dumpProfile();
+
+    /* serializing access to the opencl queue and buffers */
+    std::recursive_mutex deviceMutex;
+
+    /* ps parameters adjustable by user input */
+    ReconstructionParams params;
+    std::mutex paramsMutex;
+
+    /* model size */
+    int width, height;
+
+    /* non-changing x,y coordinates of 3d model */
+    cv::Mat XCoords, YCoords;
+
+    /* pseudo-inverses of the light directions for the full set, all sets
+       without one and all sets without two lights: 1 + 8 + 28 */
+    static const int NUM_LIGHT_SUBSETS = 37;
+    cv::Mat lightSrcsInv;
+    /** Pseudo-inverse of the light directions ignoring lights dropA and dropB (-1 for none) */
+    static cv::Mat invertLights(const cv::Mat &lightSrcs, int dropA, int dropB);
+
+    /* queued sets processed by the worker thread */
+    struct Task {
+        FrameSet frameSet;
+        std::promise<ReconstructionResult> result;
+    };
+    std::deque<Task> tasks;
+    std::mutex tasksMutex;
+    std::condition_variable taskQueued;
+    std::thread worker;
+    bool stopping;
+
+    /* work-group size of the tiled kernels, passed to ps.cl as -DTILE_SIZE */
+    static const int TILE_SIZE = 16;
+    static int roundUp(int value, int multiple);
+
+    /* active tiles, tiles outside the current list hold background on the device */
+    int numTilesX, numTilesY;
+    int curTiles;
+    int numActiveTiles[2];
+    /* active tiles of the current set merged along the tile rows, in pixels */
+    std::vector<cv::Rect> activeSpans;
+    /** whether the last calcNormals() only ran over the active tiles */
+    bool sparseNormals;
+    /** set if buffers were written densely, all tiles need resetting then */
+    bool resetAll;
+    /** Listing the active tiles of the uploaded images, resetting the previous ones */
+    void maskTiles(const ReconstructionParams &p);
+    /** Reading a buffer with dst.elemSize() bytes per pixel into dst, only the
+     * active spans if sparse, dst has to hold background elsewhere then */
+    void readPixels(const cl::Buffer &buffer, cv::Mat &dst, bool sparse, const char *name);
+    /** Reading stored normals or gradients into float dst as readPixels(),
+     * widened on the host if stored as fp16 */
+    void readStored(const cl::Buffer &buffer, cv::Mat &dst, bool sparse, const char *name);
+
+    /* share of moving pixels restarting the temporal filter entirely, and the
+       process noise relative to temporalSigma */
+    static const float MOTION_FRACTION;
+    static const float PROCESS_NOISE;
+    /** sets filtered so far, selecting the motion counter */
+    int temporalFrame;
+    bool temporalReset;
+    /** Blending the gradients and normals of the last calcNormals() into the filtered ones */
+    void filterTemporal(const ReconstructionParams &p);
+
+    /* side length of the downsampled images registered, the largest plausible
+       shift as a share of the image size and the weakest correlation peak accepted */
+    static const int REGISTRATION_SIZE = 128;
+    static const float MAX_SHIFT;
+    static const double MIN_RESPONSE;
+    /** Writing shifts of the images to the device, zero shifts if empty */
+    void uploadShifts(const std::vector<cv::Point> &shifts);
+
+    /** Building the program matching the requested options, if not cached yet,
+     * without blocking reconstructions; the kernels are swapped in afterwards */
+    void buildKernels();
+    std::string buildOptions(bool fast, bool half);
+    static void halfToFloat(const cv::Mat &src, cv::Mat &dst);
+    void processTasks();
+    cv::Mat readCalibratedLights();
+};
+
+#endif
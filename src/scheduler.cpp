@@ -0,0 +1,117 @@
+#include "scheduler.h"
+#include "photometricstereo.h"
+
+ReconstructionScheduler::ReconstructionScheduler(QObject *parent, QThreadPool *pool) : QObject(parent), pool(pool), numRunning(0), nextStation(0) {
+
+    reportTimer = new QTimer(this);
+    connect(reportTimer, SIGNAL(timeout()), this, SLOT(onReportTimer()));
+    reportClock.start();
+}
+
+ReconstructionScheduler::~ReconstructionScheduler() {
+
+    /* jobs still running reference this scheduler */
+    pool->waitForDone();
+}
+
+int ReconstructionScheduler::addStation(PhotometricStereo *ps, const QString &name) {
+
+    QMutexLocker locker(&mutex);
+    Station s;
+    s.ps = ps;
+    s.name = name;
+    s.pending = s.running = false;
+    s.completed = s.dropped = 0;
+    s.busyMSecs = s.maxMSecs = 0;
+    stations.push_back(s);
+    return stations.size()-1;
+}
+
+void ReconstructionScheduler::submit(PhotometricStereo *ps) {
+
+    QMutexLocker locker(&mutex);
+    for (size_t i=0; i<stations.size(); i++) {
+        if (stations[i].ps == ps) {
+            if (stations[i].pending) {
+                /* previous set was never started, replaced by the current one */
+                stations[i].dropped++;
+            }
+            stations[i].pending = true;
+            break;
+        }
+    }
+    dispatch();
+}
+
+void ReconstructionScheduler::dispatch() {
+
+    /* round-robin over stations, starting after the last one served */
+    int n = stations.size();
+    for (int k=0; k<n && numRunning < pool->maxThreadCount(); k++) {
+        int idx = (nextStation + k) % n;
+        Station &s = stations[idx];
+        if (s.pending && !s.running) {
+            s.pending = false;
+            s.running = true;
+            numRunning++;
+            nextStation = (idx+1) % n;
+            pool->start(new Job(this, idx, s.ps));
+        }
+    }
+}
+
+void ReconstructionScheduler::finished(int stationIdx, qint64 msecs) {
+
+    QMutexLocker locker(&mutex);
+    Station &s = stations[stationIdx];
+    s.running = false;
+    s.completed++;
+    s.busyMSecs += msecs;
+    s.maxMSecs = std::max(s.maxMSecs, msecs);
+    numRunning--;
+    dispatch();
+}
+
+ReconstructionScheduler::Job::Job(ReconstructionScheduler *scheduler, int stationIdx, PhotometricStereo *ps) : scheduler(scheduler), stationIdx(stationIdx), ps(ps) {
+
+    setAutoDelete(true);
+}
+
+void ReconstructionScheduler::Job::run() {
+
+    QElapsedTimer t;
+    t.start();
+    ps->execute();
+    scheduler->finished(stationIdx, t.elapsed());
+}
+
+QString ReconstructionScheduler::statistics() {
+
+    QMutexLocker locker(&mutex);
+    double secs = std::max(reportClock.restart(), (qint64)1) / 1000.0;
+
+    QString stats;
+    for (size_t i=0; i<stations.size(); i++) {
+        Station &s = stations[i];
+        double avg = (s.completed > 0) ? (double)s.busyMSecs/s.completed : 0.0;
+        stats += QString("%1: %2 sets/s, %3 ms avg, %4 ms max, %5 dropped\n")
+                .arg(s.name).arg(s.completed/secs, 0, 'f', 1).arg(avg, 0, 'f', 1).arg(s.maxMSecs).arg(s.dropped);
+        s.completed = s.dropped = 0;
+        s.busyMSecs = s.maxMSecs = 0;
+    }
+    return stats;
+}
+
+void ReconstructionScheduler::setReportInterval(int msecs) {
+
+    if (msecs > 0) {
+        reportTimer->start(msecs);
+    } else {
+        reportTimer->stop();
+    }
+}
+
+void ReconstructionScheduler::onReportTimer() {
+
+    emit report(statistics());
+}
@@ -0,0 +1,77 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <algorithm>
+#include <vector>
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QMutex>
+#include <QtCore/QTimer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QThreadPool>
+#include <QtCore/QRunnable>
+
+class PhotometricStereo;
+
+/** Scheduling reconstructions of several stations (camera + ps process) on a
+ * shared worker pool. Each station has at most one reconstruction in flight,
+ * free workers are handed out round-robin so that no station starves. A set
+ * arriving while the previous one still waits is merged into it (latest set
+ * wins) and counted as dropped. */
+class ReconstructionScheduler : public QObject {
+
+    Q_OBJECT
+
+public:
+    ReconstructionScheduler(QObject *parent = 0, QThreadPool *pool = QThreadPool::globalInstance());
+    ~ReconstructionScheduler();
+    /** Register ps process, returns its station index */
+    int addStation(PhotometricStereo *ps, const QString &name);
+    /** Request reconstruction of the latest complete image set of given ps process */
+    void submit(PhotometricStereo *ps);
+    /** Human readable throughput metrics of all stations since last call */
+    QString statistics();
+    /** Emit statistics() periodically, 0 disables reporting */
+    void setReportInterval(int msecs);
+
+signals:
+    void report(QString stats);
+
+private slots:
+    void onReportTimer();
+
+private:
+    struct Station {
+        PhotometricStereo *ps;
+        QString name;
+        bool pending, running;
+        /* metrics since last report */
+        int completed, dropped;
+        qint64 busyMSecs, maxMSecs;
+    };
+
+    class Job : public QRunnable {
+    public:
+        Job(ReconstructionScheduler *scheduler, int stationIdx, PhotometricStereo *ps);
+        void run();
+    private:
+        ReconstructionScheduler *scheduler;
+        int stationIdx;
+        PhotometricStereo *ps;
+    };
+    friend class Job;
+
+    QThreadPool *pool;
+    QMutex mutex;
+    std::vector<Station> stations;
+    int numRunning, nextStation;
+    QElapsedTimer reportClock;
+    QTimer *reportTimer;
+
+    /** Hand free workers to pending stations, mutex must be held */
+    void dispatch();
+    void finished(int stationIdx, qint64 msecs);
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "trace.h"
+
+std::atomic<bool> Trace::enabled(false);
+std::chrono::steady_clock::time_point Trace::epoch = std::chrono::steady_clock::now();
+std::mutex Trace::buffersMutex;
+std::vector<std::unique_ptr<Trace::ThreadBuffer> > Trace::buffers;
+std::string Trace::exitFilename;
+
+void Trace::setEnabled(bool enabled) {
+    Trace::enabled.store(enabled);
+}
+
+int64_t Trace::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+Trace::ThreadBuffer *Trace::threadBuffer() {
+
+    /* registering is the only locked operation, done once per thread */
+    static thread_local ThreadBuffer *buffer = NULL;
+    if (buffer == NULL) {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer));
+        buffer = buffers.back().get();
+        buffer->head.store(0);
+        for (uint32_t i=0; i<ThreadBuffer::CAPACITY; i++) {
+            buffer->slots[i].seq.store(0);
+        }
+        buffer->tid = (int)buffers.size();
+    }
+    return buffer;
+}
+
+void Trace::setThreadName(const std::string &name) {
+
+    ThreadBuffer *buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer->name = name;
+}
+
+void Trace::record(const char *name, int64_t start, int64_t duration) {
+
+    ThreadBuffer *buffer = threadBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    Slot &slot = buffer->slots[head % ThreadBuffer::CAPACITY];
+
+    /* invalidating the slot before overwriting it, the fence orders the fields after that */
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.duration.store(duration, std::memory_order_relaxed);
+
+    /* publishing the event to dump() */
+    slot.seq.store(head+1, std::memory_order_release);
+    buffer->head.store(head+1, std::memory_order_release);
+}
+
+bool Trace::dump(const std::string &filename) {
+
+    std::ofstream out(filename.c_str());
+    if (!out.is_open()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    std::vector<Event> events;
+    for (size_t i=0; i<buffers.size(); i++) {
+        const ThreadBuffer *buffer = buffers[i].get();
+        if (!buffer->name.empty()) {
+            out << (first ? "\n" : ",\n");
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+            first = false;
+        }
+
+        /* slots overwritten while being copied are dropped, their thread never waits */
+        events.clear();
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t tail = (head > ThreadBuffer::CAPACITY) ? head - ThreadBuffer::CAPACITY : 0;
+        for (uint64_t j=tail; j<head; j++) {
+            const Slot &slot = buffer->slots[j % ThreadBuffer::CAPACITY];
+            if (slot.seq.load(std::memory_order_acquire) != j+1) {
+                continue;
+            }
+            Event event;
+            event.name = slot.name.load(std::memory_order_relaxed);
+            event.start = slot.start.load(std::memory_order_relaxed);
+            event.duration = slot.duration.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == j+1) {
+                events.push_back(event);
+            }
+        }
+
+        for (size_t j=0; j<events.size(); j++) {
+            const Event &event = events[j];
+            out << (first ? "\n" : ",\n");
+            out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+
+    return out.good();
+}
+
+void Trace::dumpAtExit(const std::string &filename) {
+
+    /* statics of this file are constructed before, hence destroyed after the handler ran */
+    if (exitFilename.empty()) {
+        std::atexit(&Trace::dumpExitFile);
+    }
+    exitFilename = filename;
+}
+
+void Trace::dumpExitFile() {
+
+    if (dump(exitFilename)) {
+        std::cout << "Trace written to " << exitFilename << std::endl;
+    } else {
+        std::cerr << "ERROR: Could not write trace to " << exitFilename << std::endl;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <stdint.h>
+
+/** Marks the enclosing scope as a named span of the current thread's trace.
+ * Name must be a string literal, only its pointer is stored. */
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_CONCAT_(a, b) a##b
+
+/** Low overhead tracing of hot paths. Each thread records spans into its own
+ * ring buffer without locking, the buffers are dumped as Chrome trace event
+ * json (chrome://tracing, Perfetto). Recording is disabled by default, then a
+ * trace point costs a single atomic load. */
+class Trace {
+
+public:
+    /** Span which is recorded when going out of scope */
+    class Scope {
+    public:
+        explicit Scope(const char *name) : name(name), start(Trace::isEnabled() ? Trace::now() : -1) {}
+        ~Scope() { if (start >= 0) Trace::record(name, start, Trace::now()-start); }
+    private:
+        const char *name;
+        int64_t start;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    /** Names the calling thread in the dump */
+    static void setThreadName(const std::string &name);
+    /** Writing all recorded spans, spans being recorded meanwhile may be missing;
+     * safe to call while other threads are recording */
+    static bool dump(const std::string &filename);
+    /** Dumping once the process exits */
+    static void dumpAtExit(const std::string &filename);
+    /** Microseconds since start of tracing */
+    static int64_t now();
+    static void record(const char *name, int64_t start, int64_t duration);
+
+private:
+    struct Event {
+        const char *name;
+        int64_t start, duration;
+    };
+
+    /** Event slot guarded by a sequence number, the index of the event it
+     * holds plus one, or 0 while the event is being written */
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        std::atomic<const char*> name;
+        std::atomic<int64_t> start, duration;
+    };
+
+    /** Single producer ring buffer, oldest spans are overwritten. Readers drop
+     * slots whose sequence number changed while they were read. */
+    struct ThreadBuffer {
+        static const uint32_t CAPACITY = 1 << 14;
+        Slot slots[CAPACITY];
+        std::atomic<uint64_t> head;
+        int tid;
+        std::string name;
+    };
+
+    static std::atomic<bool> enabled;
+    static std::chrono::steady_clock::time_point epoch;
+
+    /* buffers outlive their threads so spans of finished threads are dumped too */
+    static std::mutex buffersMutex;
+    static std::vector<std::unique_ptr<ThreadBuffer> > buffers;
+
+    static std::string exitFilename;
+    static void dumpExitFile();
+
+    static ThreadBuffer *threadBuffer();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#ifndef FIXTURES_H
+#define FIXTURES_H
+
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "../src/reconstructionengine.h"
+#include "../src/framepreprocessor.h"
+#include "../src/config.h"
+
+/* Butterfly assets scaled to square models of given size and engines of that
+ * size, shared by the benchmarks and the tests. */
+
+struct Assets {
+    /* raw frames at camera aspect ratio, scaled so their height equals size */
+    std::vector<cv::Mat> raw;
+    cv::Mat rawAmbient;
+    /* ambient subtracted and cropped as fed to the engine */
+    FrameSet frameSet;
+    int minIntensity;
+};
+
+static const Assets &loadAssets(int size) {
+
+    static std::map<int, Assets> cache;
+    std::map<int, Assets>::iterator it = cache.find(size);
+    if (it != cache.end()) {
+        return it->second;
+    }
+
+    Assets &a = cache[size];
+    for (int i=0; i<=8; i++) {
+        std::stringstream path;
+        path << PATH_ASSETS << "butterfly/";
+        if (i < 8) {
+            path << "image" << i << ".png";
+        } else {
+            path << "image_ambient.png";
+        }
+        cv::Mat img = cv::imread(path.str(), CV_LOAD_IMAGE_GRAYSCALE);
+        if (img.empty()) {
+            std::cerr << "ERROR: Could not read " << path.str() << std::endl;
+            std::exit(1);
+        }
+        cv::Mat scaled;
+        cv::resize(img, scaled, cv::Size(img.cols*size/img.rows, size), 0, 0, cv::INTER_AREA);
+        if (i < 8) {
+            a.raw.push_back(scaled);
+        } else {
+            a.rawAmbient = scaled;
+        }
+    }
+
+    for (int i=0; i<8; i++) {
+        a.frameSet.push_back(FramePreprocessor::removeAmbient(a.raw[i], a.rawAmbient, size));
+    }
+    a.minIntensity = std::max(1, (int)cv::mean(a.rawAmbient)[0]);
+
+    return a;
+}
+
+/* one engine per size, building the OpenCL program is neither measured nor tested */
+static ReconstructionEngine &engineFor(int size) {
+
+    static std::map<int, ReconstructionEngine*> engines;
+    ReconstructionEngine *&engine = engines[size];
+    if (engine == NULL) {
+        engine = new ReconstructionEngine(size, size, loadAssets(size).minIntensity);
+    }
+    return *engine;
+}
+
+/** Deviation of a reconstruction from a reference one */
+struct Accuracy {
+    /** largest angle between normals in degrees */
+    double maxNormalErrDeg;
+    /** largest height difference relative to the height range of the reference */
+    double maxDepthErrRel;
+};
+
+static Accuracy compareResults(const ReconstructionResult &reference, const ReconstructionResult &other) {
+
+    Accuracy accuracy;
+    accuracy.maxNormalErrDeg = 0;
+    for (int i=0; i<reference.Normals.rows; i++) {
+        for (int j=0; j<reference.Normals.cols; j++) {
+            cv::Vec3f a = reference.Normals.at<cv::Vec3f>(i, j);
+            cv::Vec3f b = other.Normals.at<cv::Vec3f>(i, j);
+            double cosAngle = std::max(-1.0, std::min(1.0, (double)a.dot(b) / (cv::norm(a)*cv::norm(b) + 1e-12)));
+            accuracy.maxNormalErrDeg = std::max(accuracy.maxNormalErrDeg, std::acos(cosAngle) * 180.0 / CV_PI);
+        }
+    }
+    double minZ, maxZ;
+    cv::minMaxLoc(reference.Zcoords, &minZ, &maxZ);
+    accuracy.maxDepthErrRel = cv::norm(reference.Zcoords, other.Zcoords, cv::NORM_INF) / std::max(1e-12, maxZ-minZ);
+    return accuracy;
+}
+
+#endif
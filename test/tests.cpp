@@ -0,0 +1,364 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+
+#include "fixtures.h"
+#include "../src/modelstream.h"
+#include "../src/modelrecorder.h"
+
+/* Checks of the reconstruction engine on the butterfly assets. Every test is
+ * registered with ctest by its name, running the executable without arguments
+ * runs all of them. Tests print what they measured and return false on failure. */
+
+#define CHECK(cond, what) \
+    if (!(cond)) { \
+        std::cerr << "FAILED: " << what << " (" << #cond << ")" << std::endl; \
+        return false; \
+    }
+
+/* fast relaxed math may cost precision, but not visibly */
+static bool testFastMath() {
+
+    int size = 240;
+    ReconstructionEngine &engine = engineFor(size);
+    const FrameSet &frameSet = loadAssets(size).frameSet;
+
+    ReconstructionResult precise = engine.reconstruct(frameSet);
+    engine.setFastMath(true);
+    ReconstructionResult fast = engine.reconstruct(frameSet);
+    engine.setFastMath(false);
+
+    Accuracy accuracy = compareResults(precise, fast);
+    std::cout << "max normal error " << accuracy.maxNormalErrDeg << " deg, max depth error " << accuracy.maxDepthErrRel << std::endl;
+    CHECK(accuracy.maxNormalErrDeg < 1.0, "fast math normals deviate");
+    CHECK(accuracy.maxDepthErrRel < 0.01, "fast math heights deviate");
+    return true;
+}
+
+/* fp16 storage of normals and gradients against fp32 storage */
+static bool testHalfStorage() {
+
+    int size = 240;
+    ReconstructionEngine &engine = engineFor(size);
+    const FrameSet &frameSet = loadAssets(size).frameSet;
+
+    ReconstructionResult precise = engine.reconstruct(frameSet);
+    engine.setHalfStorage(true);
+    ReconstructionResult half = engine.reconstruct(frameSet);
+    engine.setHalfStorage(false);
+
+    Accuracy accuracy = compareResults(precise, half);
+    std::cout << "max normal error " << accuracy.maxNormalErrDeg << " deg, max depth error " << accuracy.maxDepthErrRel << std::endl;
+    CHECK(accuracy.maxNormalErrDeg < 1.0, "half storage normals deviate");
+    CHECK(accuracy.maxDepthErrRel < 0.01, "half storage heights deviate");
+    return true;
+}
+
+/* hemisphere on a plane facing away, covering both halves of the octahedral normal encoding */
+static void sphereModel(int size, cv::Mat &Z, cv::Mat &Normals) {
+
+    Z.create(size, size, CV_32F);
+    Normals.create(size, size, CV_32FC3);
+    float r = size * 0.4f;
+    for (int i=0; i<size; i++) {
+        for (int j=0; j<size; j++) {
+            float x = j - size/2.0f, y = i - size/2.0f;
+            float d = r*r - x*x - y*y;
+            if (d > 0) {
+                Z.at<float>(i, j) = std::sqrt(d);
+                Normals.at<cv::Vec3f>(i, j) = cv::Vec3f(x/r, y/r, std::sqrt(d)/r);
+            } else {
+                Z.at<float>(i, j) = 0;
+                Normals.at<cv::Vec3f>(i, j) = cv::Vec3f(0.6f, 0, -0.8f);
+            }
+        }
+    }
+}
+
+/* model of a chunk decoded again, heights within a 16-bit step of their range or exact as float */
+static bool testModelStreamRoundTrip() {
+
+    int size = 120;
+    cv::Mat Z, Normals;
+    sphereModel(size, Z, Normals);
+    double zMin, zMax;
+    cv::minMaxLoc(Z, &zMin, &zMax);
+
+    for (int floatDepth=0; floatDepth<2; floatDepth++) {
+        QByteArray chunk = ModelStream::encode(Z, Normals, 42, floatDepth != 0);
+        cv::Mat Zdec, Ndec;
+        CHECK(ModelStream::decode(chunk, size, size, Zdec, Ndec), "chunk can not be decoded");
+        double zErr = cv::norm(Z, Zdec, cv::NORM_INF);
+        double nErr = cv::norm(Normals, Ndec, cv::NORM_INF);
+        std::cout << (floatDepth ? "float" : "16-bit") << " depth: " << chunk.size() << " bytes, max height error "
+                  << zErr << ", max normal error " << nErr << std::endl;
+        CHECK(zErr <= (floatDepth ? 0.0 : (zMax - zMin) / 65535.0 * 0.51), "decoded heights deviate");
+        CHECK(nErr < 1e-3, "decoded normals deviate");
+    }
+
+    /* truncated chunks are rejected */
+    QByteArray chunk = ModelStream::encode(Z, Normals, 0, false);
+    cv::Mat Zdec, Ndec;
+    CHECK(!ModelStream::decode(chunk.left(chunk.size()/2), size, size, Zdec, Ndec), "truncated chunk is decoded");
+    return true;
+}
+
+/* stream written by the recorder, read back once closed and once as if the recorder had been killed */
+static bool testModelRecorderRoundTrip() {
+
+    int size = 120;
+    cv::Mat Z, Normals;
+    sphereModel(size, Z, Normals);
+    QString filename = QDir(QDir::tempPath()).filePath("test_models.rpsm");
+
+    ModelRecorder recorder;
+    CHECK(recorder.open(filename, size, size, false), "stream can not be created");
+    int numAppended = 5;
+    for (int k=0; k<numAppended; k++) {
+        std::vector<cv::Mat> MatXYZN(4);
+        MatXYZN[2] = Z + k;
+        MatXYZN[3] = Normals;
+        recorder.append(MatXYZN);
+    }
+    recorder.close();
+    int numModels = numAppended - recorder.droppedModels();
+
+    for (int killed=0; killed<2; killed++) {
+        if (killed) {
+            /* dropping the index, as if the stream had never been closed */
+            QFile file(filename);
+            ModelStreamHeader header;
+            CHECK(file.open(QIODevice::ReadWrite) && file.read((char*)&header, sizeof(header)) == sizeof(header), "stream can not be modified");
+            qint64 indexOffset = header.indexOffset;
+            header.indexOffset = 0;
+            header.modelCount = 0;
+            file.seek(0);
+            file.write((const char*)&header, sizeof(header));
+            file.resize(indexOffset);
+            file.close();
+        }
+
+        ModelStreamReader reader;
+        CHECK(reader.open(filename), "stream can not be opened");
+        std::cout << (killed ? "scanned: " : "indexed: ") << reader.modelCount() << " of " << numModels << " models" << std::endl;
+        CHECK(reader.width() == size && reader.height() == size, "stream has the wrong size");
+        CHECK(reader.modelCount() == numModels, "models are missing");
+        int64_t lastTimestamp = -1;
+        for (int k=0; k<reader.modelCount(); k++) {
+            cv::Mat Zdec, Ndec;
+            CHECK(reader.read(k, Zdec, Ndec), "model can not be read");
+            CHECK(reader.timestamp(k) >= lastTimestamp, "models are out of order");
+            lastTimestamp = reader.timestamp(k);
+            CHECK(cv::norm(Normals, Ndec, cv::NORM_INF) < 1e-3, "recorded normals deviate");
+        }
+        reader.close();
+    }
+
+    QFile::remove(filename);
+    return true;
+}
+
+/* images of a set moved by given offset, uncovered pixels are black */
+static FrameSet shiftedSet(const FrameSet &frameSet, int dx, int dy) {
+
+    cv::Mat shift = (cv::Mat_<double>(2, 3) << 1, 0, dx, 0, 1, dy);
+    FrameSet shifted;
+    for (size_t i=0; i<frameSet.size(); i++) {
+        cv::Mat img;
+        cv::warpAffine(frameSet[i], img, shift, frameSet[i].size());
+        shifted.push_back(img);
+    }
+    return shifted;
+}
+
+/* still sequence with reproducible noise of a few gray values */
+static std::vector<FrameSet> noisySequence(const FrameSet &frameSet, int length) {
+
+    cv::RNG rng(1);
+    std::vector<FrameSet> sequence(length);
+    for (int k=0; k<length; k++) {
+        for (size_t i=0; i<frameSet.size(); i++) {
+            cv::Mat noise(frameSet[i].size(), CV_16S), noisy;
+            rng.fill(noise, cv::RNG::NORMAL, 0, 4);
+            cv::add(frameSet[i], noise, noisy, cv::noArray(), frameSet[i].type());
+            sequence[k].push_back(noisy);
+        }
+    }
+    return sequence;
+}
+
+/* mean over all pixels of the variance of the x gradients along a sequence,
+   the first sets are left to the filter to settle */
+static double gradientVariance(ReconstructionEngine &engine, const ReconstructionParams &p, const std::vector<FrameSet> &sequence) {
+
+    int size = engine.getWidth();
+    cv::Mat Pgrads(size, size, CV_32F), Qgrads(size, size, CV_32F);
+    cv::Mat sum = cv::Mat::zeros(size, size, CV_64F), sqSum = cv::Mat::zeros(size, size, CV_64F);
+    int settle = 4, n = 0;
+    for (size_t k=0; k<sequence.size(); k++) {
+        engine.uploadImages(sequence[k]);
+        engine.calcNormals(p, Pgrads, Qgrads);
+        if ((int)k >= settle) {
+            cv::accumulate(Pgrads, sum);
+            cv::accumulateSquare(Pgrads, sqSum);
+            n++;
+        }
+    }
+    cv::Mat mean = sum / n;
+    cv::Mat variance = sqSum / n - mean.mul(mean);
+    return cv::mean(variance)[0];
+}
+
+/* x gradients of a set relative to its unfiltered ones, 0 if the filter restarted with it */
+static double filteredDeviation(ReconstructionEngine &engine, const ReconstructionParams &p, const FrameSet &frameSet) {
+
+    int size = engine.getWidth();
+    cv::Mat filteredP(size, size, CV_32F), rawP(size, size, CV_32F), Qgrads(size, size, CV_32F);
+    engine.uploadImages(frameSet);
+    engine.calcNormals(p, filteredP, Qgrads);
+    engine.setTemporalFilter(false);
+    engine.uploadImages(frameSet);
+    engine.calcNormals(p, rawP, Qgrads);
+    return cv::norm(filteredP, rawP, cv::NORM_L1) / std::max(cv::norm(rawP, cv::NORM_L1), 1e-6);
+}
+
+/* the filter has to reduce the noise of a still sequence */
+static bool testTemporalFilterVariance() {
+
+    int size = 240;
+    ReconstructionEngine &engine = engineFor(size);
+    ReconstructionParams p = engine.getParams();
+    std::vector<FrameSet> sequence = noisySequence(loadAssets(size).frameSet, 16);
+
+    double rawVariance = gradientVariance(engine, p, sequence);
+    engine.setTemporalFilter(true);
+    double filteredVariance = gradientVariance(engine, p, sequence);
+    engine.setTemporalFilter(false);
+
+    std::cout << "gradient variance " << rawVariance << " raw, " << filteredVariance << " filtered" << std::endl;
+    CHECK(filteredVariance < 0.9 * rawVariance, "temporal filter does not reduce the variance of a still sequence");
+    return true;
+}
+
+/* the filter has to start over with a set moved by an eighth of its size, and
+   with any set following a reset */
+static bool testTemporalFilterRestart() {
+
+    int size = 240;
+    ReconstructionEngine &engine = engineFor(size);
+    ReconstructionParams p = engine.getParams();
+    const FrameSet &frameSet = loadAssets(size).frameSet;
+    std::vector<FrameSet> sequence = noisySequence(frameSet, 8);
+
+    engine.setTemporalFilter(true);
+    gradientVariance(engine, p, sequence);
+    double shiftDeviation = filteredDeviation(engine, p, shiftedSet(frameSet, size/8, 0));
+
+    engine.setTemporalFilter(true);
+    gradientVariance(engine, p, sequence);
+    engine.resetTemporalFilter();
+    double resetDeviation = filteredDeviation(engine, p, sequence[0]);
+
+    std::cout << "deviation from unfiltered gradients " << shiftDeviation << " after a shift, " << resetDeviation << " after a reset" << std::endl;
+    CHECK(shiftDeviation < 0.25, "temporal filter does not restart after a shifted set");
+    CHECK(resetDeviation < 1e-3, "temporal filter does not restart after a reset");
+    return true;
+}
+
+/* mean angle between normals in degrees, ignoring a border of the given width */
+static double meanNormalErrDeg(const cv::Mat &reference, const cv::Mat &other, int border) {
+
+    double sum = 0;
+    int n = 0;
+    for (int i=border; i<reference.rows-border; i++) {
+        for (int j=border; j<reference.cols-border; j++) {
+            cv::Vec3f a = reference.at<cv::Vec3f>(i, j);
+            cv::Vec3f b = other.at<cv::Vec3f>(i, j);
+            double cosAngle = std::max(-1.0, std::min(1.0, (double)a.dot(b) / (cv::norm(a)*cv::norm(b) + 1e-12)));
+            sum += std::acos(cosAngle) * 180.0 / CV_PI;
+            n++;
+        }
+    }
+    return sum / std::max(n, 1);
+}
+
+/* one image of the set moved by a known offset has to be registered with that
+   offset, as added to the coordinates the kernels sample it at, and the set has
+   to reconstruct as the unmoved one apart from the uncovered border */
+static bool testRegistration() {
+
+    int size = 240, moved = 3, dx = 6, dy = -4;
+    ReconstructionEngine &engine = engineFor(size);
+    const FrameSet &frameSet = loadAssets(size).frameSet;
+
+    FrameSet shifted = frameSet;
+    shifted[moved] = shiftedSet(FrameSet(1, frameSet[moved]), dx, dy)[0];
+
+    std::vector<cv::Point> shifts = engine.registerImages(shifted);
+    std::cout << "shift of image " << moved << " registered as " << shifts[moved].x << "," << shifts[moved].y << std::endl;
+    CHECK(std::abs(shifts[moved].x - dx) <= 1 && std::abs(shifts[moved].y - dy) <= 1, "registered shift deviates from the applied one");
+    for (size_t k=0; k<shifts.size(); k++) {
+        CHECK(k == (size_t)moved || shifts[k] == cv::Point(0, 0), "unmoved image registered as shifted");
+    }
+
+    ReconstructionResult reference = engine.reconstruct(frameSet);
+    ReconstructionResult uncompensated = engine.reconstruct(shifted);
+    engine.setMotionCompensation(true);
+    ReconstructionResult compensated = engine.reconstruct(shifted);
+    engine.setMotionCompensation(false);
+
+    int border = size/8;
+    double uncompensatedErr = meanNormalErrDeg(reference.Normals, uncompensated.Normals, border);
+    double compensatedErr = meanNormalErrDeg(reference.Normals, compensated.Normals, border);
+    std::cout << "mean normal error " << uncompensatedErr << " deg uncompensated, " << compensatedErr << " deg compensated" << std::endl;
+    CHECK(compensatedErr < 0.5, "re-aligned images do not reconstruct as the unmoved ones");
+    CHECK(compensatedErr < 0.5 * uncompensatedErr, "motion compensation does not improve the normals");
+    return true;
+}
+
+struct Test {
+    const char *name;
+    bool (*run)();
+};
+
+static const Test tests[] = {
+    {"fast_math", &testFastMath},
+    {"half_storage", &testHalfStorage},
+    {"model_stream", &testModelStreamRoundTrip},
+    {"model_recorder", &testModelRecorderRoundTrip},
+    {"temporal_filter_variance", &testTemporalFilterVariance},
+    {"temporal_filter_restart", &testTemporalFilterRestart},
+    {"registration", &testRegistration}
+};
+
+int main(int argc, char **argv) {
+
+    int numTests = sizeof(tests) / sizeof(tests[0]);
+    int numRun = 0, numFailed = 0;
+    for (int i=0; i<numTests; i++) {
+        bool selected = (argc < 2);
+        for (int k=1; k<argc; k++) {
+            selected = selected || strcmp(argv[k], tests[i].name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+
+        std::cout << "[" << tests[i].name << "]" << std::endl;
+        numRun++;
+        if (!tests[i].run()) {
+            numFailed++;
+        }
+    }
+
+    if (numRun == 0) {
+        std::cerr << "ERROR: No such test" << std::endl;
+        return 1;
+    }
+    std::cout << numRun-numFailed << " of " << numRun << " tests passed" << std::endl;
+    return (numFailed == 0) ? 0 : 1;
+}